@@ -123,8 +123,9 @@ float3 Shade(VS_OUTPUT input)
     //Normal map
     float3   binormal = normalize(cross(input.Normal, input.Tangent));
     float3x3 tangentSpaceAxis = float3x3(normalize(input.Tangent), binormal, input.Normal);
-    float3   normalMapSample = gNormalMap.Sample(gSamplerState, input.UV);
-    input.Normal = normalize(mul(2.f * normalMapSample - 1.f, tangentSpaceAxis));
+    float2   normalMapSample = 2.f * gNormalMap.Sample(gSamplerState, input.UV).xy - 1.f;
+    float3   tangentSpaceNormal = float3(normalMapSample, sqrt(saturate(1.f - dot(normalMapSample, normalMapSample)))); //BC5 only stores x and y
+    input.Normal = normalize(mul(tangentSpaceNormal, tangentSpaceAxis));
     
     //Observed area
     float cosOfAngle = dot(input.Normal, -gLightDirection);
@@ -0,0 +1,23 @@
+#include "AssetLoader.h"
+#include "Utils.h"
+
+namespace dae
+{
+	std::future<std::unique_ptr<TextureData>> AssetLoader::LoadTexture(const std::string& textureFile, TextureFormat format)
+	{
+		return m_ThreadPool.Submit([textureFile, format]()
+			{
+				return Texture::Decode(textureFile, format);
+			});
+	}
+
+	std::future<MeshData> AssetLoader::LoadMesh(const std::string& objFile)
+	{
+		return m_ThreadPool.Submit([objFile]()
+			{
+				MeshData meshData;
+				Utils::ParseOBJ(objFile, meshData.vertices, meshData.indices);
+				return meshData;
+			});
+	}
+}
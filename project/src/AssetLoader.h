@@ -0,0 +1,33 @@
+#pragma once
+#include "pch.h"
+#include "DataTypes.h"
+#include "Texture.h"
+#include "ThreadPool.h"
+
+namespace dae
+{
+	struct MeshData
+	{
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+	};
+
+	// Decodes textures and parses meshes on a thread pool, GPU uploads stay with the caller
+	class AssetLoader final
+	{
+	public:
+		AssetLoader() = default;
+		~AssetLoader() = default;
+
+		AssetLoader(const AssetLoader&) = delete;
+		AssetLoader(AssetLoader&&) noexcept = delete;
+		AssetLoader& operator=(const AssetLoader&) = delete;
+		AssetLoader& operator=(AssetLoader&&) noexcept = delete;
+
+		std::future<std::unique_ptr<TextureData>> LoadTexture(const std::string& textureFile, TextureFormat format = TextureFormat::R8G8B8A8);
+		std::future<MeshData> LoadMesh(const std::string& objFile);
+
+	private:
+		ThreadPool m_ThreadPool{};
+	};
+}
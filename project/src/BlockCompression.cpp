@@ -0,0 +1,345 @@
+#include "BlockCompression.h"
+#include <cfloat>
+#include <climits>
+#include <cstring>
+
+namespace dae
+{
+	namespace BlockCompression
+	{
+		namespace
+		{
+			uint16_t PackRGB565(const float* color)
+			{
+				const int r = std::clamp(int(color[0] * 31.f / 255.f + .5f), 0, 31);
+				const int g = std::clamp(int(color[1] * 63.f / 255.f + .5f), 0, 63);
+				const int b = std::clamp(int(color[2] * 31.f / 255.f + .5f), 0, 31);
+				return uint16_t(r << 11 | g << 5 | b);
+			}
+
+			void UnpackRGB565(uint16_t color, int* pRGB)
+			{
+				const int r = color >> 11;
+				const int g = (color >> 5) & 63;
+				const int b = color & 31;
+				pRGB[0] = (r << 3) | (r >> 2);
+				pRGB[1] = (g << 2) | (g >> 4);
+				pRGB[2] = (b << 3) | (b >> 2);
+			}
+
+			void BuildColorPalette(uint16_t color0, uint16_t color1, bool isFourColorMode, int palette[4][4])
+			{
+				UnpackRGB565(color0, palette[0]);
+				UnpackRGB565(color1, palette[1]);
+				palette[0][3] = 255;
+				palette[1][3] = 255;
+
+				for (int c = 0; c < 3; ++c)
+				{
+					if (isFourColorMode)
+					{
+						palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+						palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+					}
+					else
+					{
+						palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+						palette[3][c] = 0;
+					}
+				}
+				palette[2][3] = 255;
+				palette[3][3] = isFourColorMode ? 255 : 0;
+			}
+
+			void BuildAlphaPalette(uint8_t alpha0, uint8_t alpha1, int palette[8])
+			{
+				palette[0] = alpha0;
+				palette[1] = alpha1;
+				if (alpha0 > alpha1)
+				{
+					for (int i = 1; i < 7; ++i)
+					{
+						palette[i + 1] = ((7 - i) * alpha0 + i * alpha1 + 3) / 7;
+					}
+				}
+				else
+				{
+					for (int i = 1; i < 5; ++i)
+					{
+						palette[i + 1] = ((5 - i) * alpha0 + i * alpha1 + 2) / 5;
+					}
+					palette[6] = 0;
+					palette[7] = 255;
+				}
+			}
+
+			// BC1 colour block, the principal axis of the block's colours gives the two endpoints
+			void EncodeColorBlock(const uint8_t* pTexels, uint8_t* pBlock)
+			{
+				float mean[3]{};
+				for (int i = 0; i < TexelsPerBlock; ++i)
+				{
+					for (int c = 0; c < 3; ++c) mean[c] += pTexels[i * 4 + c];
+				}
+				for (float& m : mean) m /= float(TexelsPerBlock);
+
+				float covariance[6]{};
+				for (int i = 0; i < TexelsPerBlock; ++i)
+				{
+					const float r = pTexels[i * 4 + 0] - mean[0];
+					const float g = pTexels[i * 4 + 1] - mean[1];
+					const float b = pTexels[i * 4 + 2] - mean[2];
+					covariance[0] += r * r;
+					covariance[1] += r * g;
+					covariance[2] += r * b;
+					covariance[3] += g * g;
+					covariance[4] += g * b;
+					covariance[5] += b * b;
+				}
+
+				float axis[3]{ 1.f, 1.f, 1.f };
+				for (int iteration = 0; iteration < 4; ++iteration)
+				{
+					const float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+					const float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+					const float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+					const float length = std::max({ std::abs(x), std::abs(y), std::abs(z) });
+					if (length < FLT_EPSILON) break;
+					axis[0] = x / length;
+					axis[1] = y / length;
+					axis[2] = z / length;
+				}
+
+				int minIndex{}, maxIndex{};
+				float minProjection{ FLT_MAX }, maxProjection{ -FLT_MAX };
+				for (int i = 0; i < TexelsPerBlock; ++i)
+				{
+					const float projection = pTexels[i * 4 + 0] * axis[0] + pTexels[i * 4 + 1] * axis[1] + pTexels[i * 4 + 2] * axis[2];
+					if (projection < minProjection) { minProjection = projection; minIndex = i; }
+					if (projection > maxProjection) { maxProjection = projection; maxIndex = i; }
+				}
+
+				const float maxColor[3]{ float(pTexels[maxIndex * 4]), float(pTexels[maxIndex * 4 + 1]), float(pTexels[maxIndex * 4 + 2]) };
+				const float minColor[3]{ float(pTexels[minIndex * 4]), float(pTexels[minIndex * 4 + 1]), float(pTexels[minIndex * 4 + 2]) };
+				uint16_t color0 = PackRGB565(maxColor);
+				uint16_t color1 = PackRGB565(minColor);
+				if (color0 < color1) std::swap(color0, color1);
+
+				uint32_t indices{};
+				if (color0 != color1)
+				{
+					int palette[4][4];
+					BuildColorPalette(color0, color1, true, palette);
+
+					for (int i = 0; i < TexelsPerBlock; ++i)
+					{
+						int bestIndex{};
+						int bestDistance{ INT_MAX };
+						for (int p = 0; p < 4; ++p)
+						{
+							const int dr = pTexels[i * 4 + 0] - palette[p][0];
+							const int dg = pTexels[i * 4 + 1] - palette[p][1];
+							const int db = pTexels[i * 4 + 2] - palette[p][2];
+							const int distance = dr * dr + dg * dg + db * db;
+							if (distance < bestDistance)
+							{
+								bestDistance = distance;
+								bestIndex = p;
+							}
+						}
+						indices |= uint32_t(bestIndex) << (i * 2);
+					}
+				}
+
+				memcpy(pBlock, &color0, 2);
+				memcpy(pBlock + 2, &color1, 2);
+				memcpy(pBlock + 4, &indices, 4);
+			}
+
+			// BC4 single channel block, used for BC3 alpha and both BC5 channels
+			void EncodeChannelBlock(const uint8_t* pTexels, int channel, uint8_t* pBlock)
+			{
+				uint8_t minValue{ 255 }, maxValue{ 0 };
+				for (int i = 0; i < TexelsPerBlock; ++i)
+				{
+					minValue = std::min(minValue, pTexels[i * 4 + channel]);
+					maxValue = std::max(maxValue, pTexels[i * 4 + channel]);
+				}
+
+				pBlock[0] = maxValue;
+				pBlock[1] = minValue;
+
+				uint64_t indices{};
+				if (maxValue != minValue)
+				{
+					int palette[8];
+					BuildAlphaPalette(maxValue, minValue, palette);
+
+					for (int i = 0; i < TexelsPerBlock; ++i)
+					{
+						int bestIndex{};
+						int bestDistance{ INT_MAX };
+						for (int p = 0; p < 8; ++p)
+						{
+							const int distance = std::abs(pTexels[i * 4 + channel] - palette[p]);
+							if (distance < bestDistance)
+							{
+								bestDistance = distance;
+								bestIndex = p;
+							}
+						}
+						indices |= uint64_t(bestIndex) << (i * 3);
+					}
+				}
+
+				for (int i = 0; i < 6; ++i)
+				{
+					pBlock[2 + i] = uint8_t(indices >> (i * 8));
+				}
+			}
+
+			void DecodeColorBlock(const uint8_t* pBlock, bool isFourColorMode, uint8_t* pTexels)
+			{
+				uint16_t color0, color1;
+				uint32_t indices;
+				memcpy(&color0, pBlock, 2);
+				memcpy(&color1, pBlock + 2, 2);
+				memcpy(&indices, pBlock + 4, 4);
+
+				int palette[4][4];
+				BuildColorPalette(color0, color1, isFourColorMode || color0 > color1, palette);
+
+				for (int i = 0; i < TexelsPerBlock; ++i)
+				{
+					const int* color = palette[(indices >> (i * 2)) & 3];
+					pTexels[i * 4 + 0] = uint8_t(color[0]);
+					pTexels[i * 4 + 1] = uint8_t(color[1]);
+					pTexels[i * 4 + 2] = uint8_t(color[2]);
+					pTexels[i * 4 + 3] = uint8_t(color[3]);
+				}
+			}
+
+			void DecodeChannelBlock(const uint8_t* pBlock, int channel, uint8_t* pTexels)
+			{
+				int palette[8];
+				BuildAlphaPalette(pBlock[0], pBlock[1], palette);
+
+				uint64_t indices{};
+				for (int i = 0; i < 6; ++i)
+				{
+					indices |= uint64_t(pBlock[2 + i]) << (i * 8);
+				}
+
+				for (int i = 0; i < TexelsPerBlock; ++i)
+				{
+					pTexels[i * 4 + channel] = uint8_t(palette[(indices >> (i * 3)) & 7]);
+				}
+			}
+		}
+
+		int GetBlockSize(TextureFormat format)
+		{
+			switch (format)
+			{
+			case TextureFormat::BC1:
+				return 8;
+			case TextureFormat::BC3:
+			case TextureFormat::BC5:
+				return 16;
+			default:
+				return 0;
+			}
+		}
+
+		DXGI_FORMAT GetDXGIFormat(TextureFormat format)
+		{
+			switch (format)
+			{
+			case TextureFormat::BC1:
+				return DXGI_FORMAT_BC1_UNORM;
+			case TextureFormat::BC3:
+				return DXGI_FORMAT_BC3_UNORM;
+			case TextureFormat::BC5:
+				return DXGI_FORMAT_BC5_UNORM;
+			default:
+				return DXGI_FORMAT_R8G8B8A8_UNORM;
+			}
+		}
+
+		void EncodeBlock(TextureFormat format, const uint8_t* pTexels, uint8_t* pBlock)
+		{
+			switch (format)
+			{
+			case TextureFormat::BC1:
+				EncodeColorBlock(pTexels, pBlock);
+				break;
+			case TextureFormat::BC3:
+				EncodeChannelBlock(pTexels, 3, pBlock);
+				EncodeColorBlock(pTexels, pBlock + 8);
+				break;
+			case TextureFormat::BC5:
+				EncodeChannelBlock(pTexels, 0, pBlock);
+				EncodeChannelBlock(pTexels, 1, pBlock + 8);
+				break;
+			default:
+				break;
+			}
+		}
+
+		void DecodeBlock(TextureFormat format, const uint8_t* pBlock, uint8_t* pTexels)
+		{
+			switch (format)
+			{
+			case TextureFormat::BC1:
+				DecodeColorBlock(pBlock, false, pTexels);
+				break;
+			case TextureFormat::BC3:
+				DecodeColorBlock(pBlock + 8, true, pTexels);
+				DecodeChannelBlock(pBlock, 3, pTexels);
+				break;
+			case TextureFormat::BC5:
+				DecodeChannelBlock(pBlock, 0, pTexels);
+				DecodeChannelBlock(pBlock + 8, 1, pTexels);
+				for (int i = 0; i < TexelsPerBlock; ++i)
+				{
+					// Rebuild z so BC5 normal maps decode like the uncompressed ones
+					const float x = 2.f * pTexels[i * 4 + 0] / 255.f - 1.f;
+					const float y = 2.f * pTexels[i * 4 + 1] / 255.f - 1.f;
+					const float z = sqrtf(std::max(0.f, 1.f - x * x - y * y));
+					pTexels[i * 4 + 2] = uint8_t((z * .5f + .5f) * 255.f + .5f);
+					pTexels[i * 4 + 3] = 255;
+				}
+				break;
+			default:
+				break;
+			}
+		}
+
+		std::vector<uint8_t> EncodeImage(TextureFormat format, const uint8_t* pPixels, int width, int height, int pitch)
+		{
+			const int blockSize = GetBlockSize(format);
+			const int blocksWide = width / BlockDimension;
+			const int blocksHigh = height / BlockDimension;
+
+			std::vector<uint8_t> blocks(size_t(blocksWide) * blocksHigh * blockSize);
+
+			// Serial, the loader pool encodes one texture per worker and is the only level of parallelism
+			for (int by = 0; by < blocksHigh; ++by)
+			{
+				uint8_t texels[TexelsPerBlock * 4];
+				for (int bx = 0; bx < blocksWide; ++bx)
+				{
+					for (int row = 0; row < BlockDimension; ++row)
+					{
+						const uint8_t* pRow = pPixels + size_t(by * BlockDimension + row) * pitch + size_t(bx) * BlockDimension * 4;
+						memcpy(texels + row * BlockDimension * 4, pRow, BlockDimension * 4);
+					}
+
+					EncodeBlock(format, texels, blocks.data() + (size_t(by) * blocksWide + bx) * blockSize);
+				}
+			}
+
+			return blocks;
+		}
+	}
+}
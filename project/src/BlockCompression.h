@@ -0,0 +1,29 @@
+#pragma once
+#include "pch.h"
+
+namespace dae
+{
+	enum class TextureFormat
+	{
+		R8G8B8A8,
+		BC1,	// RGB, 8 bytes per 4x4 block
+		BC3,	// RGBA, 16 bytes per 4x4 block
+		BC5		// RG, 16 bytes per 4x4 block, blue is rebuilt as the normal's z
+	};
+
+	namespace BlockCompression
+	{
+		constexpr int BlockDimension{ 4 };
+		constexpr int TexelsPerBlock{ BlockDimension * BlockDimension };
+
+		int GetBlockSize(TextureFormat format);
+		DXGI_FORMAT GetDXGIFormat(TextureFormat format);
+
+		// Texels are RGBA8 in memory order (r, g, b, a), 16 of them in row order
+		void EncodeBlock(TextureFormat format, const uint8_t* pTexels, uint8_t* pBlock);
+		void DecodeBlock(TextureFormat format, const uint8_t* pBlock, uint8_t* pTexels);
+
+		// Compresses a whole RGBA8 image on the calling thread, width and height must be multiples of 4
+		std::vector<uint8_t> EncodeImage(TextureFormat format, const uint8_t* pPixels, int width, int height, int pitch);
+	}
+}
@@ -28,6 +28,8 @@ namespace dae
 		Vector3 origin{};
 		float fovAngle{ 90.f };
 		float fov{ tanf((fovAngle * TO_RADIANS) / 2.f) };
+		float nearPlane{ .1f };
+		float farPlane{ 100.f };
 
 		Vector3 forward{ Vector3::UnitZ };
 		Vector3 up{ Vector3::UnitY };
@@ -68,7 +70,7 @@ namespace dae
 		{
 			if (isProjectionMatrixDirty)
 			{
-				projectionMatrix = Matrix::CreatePerspectiveFovLH(fov, width / height, .1f, 100.f);
+				projectionMatrix = Matrix::CreatePerspectiveFovLH(fov, width / height, nearPlane, farPlane);
 				isProjectionMatrixDirty = false; // Reset flag after update
 			}
 		}
@@ -21,6 +21,18 @@ namespace dae
 			return { Lerpf(c1.r, c2.r, factor), Lerpf(c1.g, c2.g, factor), Lerpf(c1.b, c2.b, factor) };
 		}
 
+		// Perspective-correct, same weights as Vector2::Interpolate
+		static ColorRGB Interpolate(const ColorRGB& c0, const ColorRGB& c1, const ColorRGB& c2, const float w0, const float w1, const float w2,
+			const float interpolationScale0, const float interpolationScale1, const float interpolationScale2,
+			const float interpolatedDepth, const float wProduct)
+		{
+			const float scale = interpolatedDepth / wProduct;
+			return {
+				(c0.r * w1 * w2 * interpolationScale0 + c1.r * w0 * w2 * interpolationScale1 + c2.r * w0 * w1 * interpolationScale2) * scale,
+				(c0.g * w1 * w2 * interpolationScale0 + c1.g * w0 * w2 * interpolationScale1 + c2.g * w0 * w1 * interpolationScale2) * scale,
+				(c0.b * w1 * w2 * interpolationScale0 + c1.b * w0 * w2 * interpolationScale1 + c2.b * w0 * w1 * interpolationScale2) * scale };
+		}
+
 		#pragma region ColorRGB (Member) Operators
 		const ColorRGB& operator+=(const ColorRGB& c)
 		{
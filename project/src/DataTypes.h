@@ -12,13 +12,16 @@ namespace dae
 		Vector3 tangent			{};
 	};
 
+	// Software varyings, shaded in object space so baked object-space normal maps need no tangent frame
 	struct Vertex_Out
 	{
 		Vector4 position		{};
 		Vector2 uv				{};
 		Vector3 normal			{};
-		Vector3 tangent			{};
 		Vector3 viewDirection	{};
+		Vector3 objectPosition	{};
+		ColorRGB diffuseLight	{};	// Gouraud only, lighting summed per vertex
+		ColorRGB specularLight	{};
 	};
 
 	enum class PrimitiveTopology
@@ -38,7 +41,9 @@ namespace dae
 		ObservedArea,
 		Diffuse,
 		Specular,
-		Combined
+		Combined,
+		Gouraud,	// Combined lit per vertex, the pixels only apply the material
+		Decoupled	// Combined lit into the mesh's texture-space cache, the pixels only fetch it
 	};
 
 	enum FilteringTechnique
@@ -62,6 +67,25 @@ namespace dae
 	};
 
 
+	enum class LightType
+	{
+		Directional,
+		Point,
+		Spot
+	};
+
+	struct Light
+	{
+		LightType type{ LightType::Directional };
+		Vector3 position{};
+		Vector3 direction{ .577f, -.577f, .577f };	// direction the light travels in, directional and spot only
+		ColorRGB color{ 1.f, 1.f, 1.f };
+		float intensity{ 7.f };
+		float range{ 10.f };						// point and spot only, no contribution beyond it
+		float innerConeCos{ .95f };					// spot only, full intensity inside the inner cone
+		float outerConeCos{ .85f };
+	};
+
 	struct Mesh
 	{
 		std::vector<Vertex> vertices{};
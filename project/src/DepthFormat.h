@@ -0,0 +1,87 @@
+#pragma once
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace dae
+{
+	// Storage of the software depth buffer
+	enum class DepthFormat
+	{
+		Float32,			// NDC depth, less-equal
+		Unorm16,			// NDC depth in 16 bits, half the traffic, for scenes without distant coplanar surfaces
+		ReversedFloat32		// 1 - NDC depth computed from the view depth, greater-equal, float precision where the depth is 1
+	};
+
+	// Encode takes the NDC depth and its reversed value, Decode gives NDC depth back with cleared pixels above 1
+	template<DepthFormat Format>
+	struct DepthTraits;
+
+	template<>
+	struct DepthTraits<DepthFormat::Float32>
+	{
+		using Storage = float;
+		static constexpr Storage Clear{ FLT_MAX };
+
+		static Storage Encode(float depth, float) { return depth; }
+		static float Decode(Storage value) { return value; }
+		// Less-equal, so the shading pass still passes where the pre-pass wrote the same depth
+		static bool Passes(Storage value, Storage stored) { return value <= stored; }
+	};
+
+	template<>
+	struct DepthTraits<DepthFormat::Unorm16>
+	{
+		using Storage = uint16_t;
+		// The top code is kept for the clear, the far plane encodes just below it
+		static constexpr Storage Clear{ UINT16_MAX };
+		static constexpr float Scale{ float(UINT16_MAX - 1) };
+
+		static Storage Encode(float depth, float) { return Storage(depth * Scale + .5f); }
+		static float Decode(Storage value) { return value == Clear ? FLT_MAX : float(value) / Scale; }
+		static bool Passes(Storage value, Storage stored) { return value <= stored; }
+	};
+
+	template<>
+	struct DepthTraits<DepthFormat::ReversedFloat32>
+	{
+		using Storage = float;
+		static constexpr Storage Clear{ -FLT_MAX };
+
+		static Storage Encode(float, float reversedDepth) { return reversedDepth; }
+		static float Decode(Storage value) { return 1.f - value; }
+		static bool Passes(Storage value, Storage stored) { return value >= stored; }
+	};
+
+	// 1 - NDC depth straight from the view depth, without the cancellation of subtracting a depth close to 1
+	inline float GetReversedDepth(float viewDepth, float nearPlane, float farPlane)
+	{
+		return nearPlane * (farPlane - viewDepth) / ((farPlane - nearPlane) * viewDepth);
+	}
+
+	// Calls function with std::integral_constant<DepthFormat, format>, so pixel loops compile once per format
+	template<typename Function>
+	decltype(auto) DispatchDepthFormat(DepthFormat format, Function&& function)
+	{
+		switch (format)
+		{
+		case DepthFormat::Unorm16:
+			return function(std::integral_constant<DepthFormat, DepthFormat::Unorm16>{});
+		case DepthFormat::ReversedFloat32:
+			return function(std::integral_constant<DepthFormat, DepthFormat::ReversedFloat32>{});
+		default:
+			return function(std::integral_constant<DepthFormat, DepthFormat::Float32>{});
+		}
+	}
+
+	// One pixel's NDC depth, for readers outside the pixel loops
+	inline float DecodeDepth(DepthFormat format, const void* pDepthBuffer, size_t pixelIndex)
+	{
+		return DispatchDepthFormat(format, [pDepthBuffer, pixelIndex](auto depthFormat)
+			{
+				using Traits = DepthTraits<decltype(depthFormat)::value>;
+				return Traits::Decode(static_cast<const typename Traits::Storage*>(pDepthBuffer)[pixelIndex]);
+			});
+	}
+}
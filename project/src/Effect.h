@@ -1,6 +1,7 @@
 #pragma once
 #include "pch.h"
 #include "Texture.h"
+#include "MaterialTexture.h"
 #include <unordered_map>
 using namespace dae;
 
@@ -43,6 +44,10 @@ public:
     {
         return nullptr;
     }
+    virtual MaterialTexture* GetMaterial()
+    {
+        return nullptr;
+    }
 
     ID3D11RasterizerState* GetCurrentRasterizerState() const;
 
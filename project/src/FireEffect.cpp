@@ -60,16 +60,6 @@ FireEffect::FireEffect(ID3D11Device* pDevice, const std::wstring& assetFile) : E
 	{
 		m_EffectSamplerVariable->SetSampler(0, m_pSamplerAnisotropic);
 	}
-
-	m_pUDiffuseTexture = Texture::LoadFromFile(pDevice, "resources/fireFX_diffuse.png");
-	ID3DX11EffectShaderResourceVariable*  pDiffuseMapVariable = m_pEffect->GetVariableByName("gDiffuseMap")->AsShaderResource();
-	if (pDiffuseMapVariable->IsValid()) {
-		pDiffuseMapVariable->SetResource(m_pUDiffuseTexture.get()->GetShaderResourceView());
-	}
-	else
-	{
-		std::wcout << L"m_pDiffuseMapVariable not valid!\n";
-	}
 }
 
 FireEffect::~FireEffect()
@@ -127,6 +117,19 @@ void FireEffect::SetAnisotropicSampling()
 	}
 }
 
+void FireEffect::SetDiffuseMap(std::unique_ptr<Texture> pDiffuseTexture)
+{
+	m_pUDiffuseTexture = std::move(pDiffuseTexture);
+	ID3DX11EffectShaderResourceVariable*  pDiffuseMapVariable = m_pEffect->GetVariableByName("gDiffuseMap")->AsShaderResource();
+	if (pDiffuseMapVariable->IsValid()) {
+		pDiffuseMapVariable->SetResource(m_pUDiffuseTexture.get()->GetShaderResourceView());
+	}
+	else
+	{
+		std::wcout << L"m_pDiffuseMapVariable not valid!\n";
+	}
+}
+
 Texture* FireEffect::GetDiffuseTexture()
 {
 	return  m_pUDiffuseTexture.get();
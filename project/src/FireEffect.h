@@ -17,6 +17,8 @@ public:
     void SetLinearSampling();
     void SetAnisotropicSampling();
 
+    void SetDiffuseMap(std::unique_ptr<Texture> pDiffuseTexture);
+
     Texture* GetDiffuseTexture() override;
 
 protected:
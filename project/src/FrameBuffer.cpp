@@ -0,0 +1,185 @@
+#include "FrameBuffer.h"
+#include <algorithm>
+#include <thread>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace dae
+{
+	int FrameBuffer::GetTiledPixelCount(int width, int height)
+	{
+		return ((width + TileSize - 1) / TileSize) * ((height + TileSize - 1) / TileSize) * TileArea;
+	}
+
+	FrameBuffer::FrameBuffer(int width, int height, uint32_t* pPresentPixels)
+		: m_Width{ width }
+		, m_Height{ height }
+		, m_TilesWide{ (width + TileSize - 1) / TileSize }
+		, m_TilesHigh{ (height + TileSize - 1) / TileSize }
+		, m_pPresentPixels{ pPresentPixels }
+		, m_Color(size_t(GetTiledPixelCount(width, height)))
+		, m_Depth(size_t(GetTiledPixelCount(width, height)))
+		, m_pTileStates{ std::make_unique<std::atomic<TileState>[]>(size_t(m_TilesWide) * m_TilesHigh) }
+	{
+	}
+
+	int FrameBuffer::GetWidth() const
+	{
+		return m_Width;
+	}
+
+	int FrameBuffer::GetHeight() const
+	{
+		return m_Height;
+	}
+
+	FrameBuffer::Layout FrameBuffer::GetLayout() const
+	{
+		return Layout{ m_Width, m_TilesWide };
+	}
+
+	uint32_t* FrameBuffer::GetColorPixels()
+	{
+		return m_Color.data();
+	}
+
+	void FrameBuffer::SetPresentPixels(uint32_t* pPresentPixels)
+	{
+		m_pPresentPixels = pPresentPixels;
+	}
+
+	void FrameBuffer::SetDepthFormat(DepthFormat depthFormat)
+	{
+		m_DepthFormat = depthFormat;
+	}
+
+	DepthFormat FrameBuffer::GetDepthFormat() const
+	{
+		return m_DepthFormat;
+	}
+
+	void* FrameBuffer::GetDepthPixels()
+	{
+		return m_Depth.data();
+	}
+
+	const void* FrameBuffer::GetDepthPixels() const
+	{
+		return m_Depth.data();
+	}
+
+	void FrameBuffer::Clear(uint32_t color)
+	{
+		m_ClearColor = color;
+
+		const int tileCount = m_TilesWide * m_TilesHigh;
+		for (int tileIndex = 0; tileIndex < tileCount; ++tileIndex)
+		{
+			m_pTileStates[tileIndex].store(TileState::Pending, std::memory_order_relaxed);
+		}
+	}
+
+	void FrameBuffer::Touch(int minX, int minY, int maxX, int maxY)
+	{
+		minX = std::max(minX, 0);
+		minY = std::max(minY, 0);
+		maxX = std::min(maxX, m_Width);
+		maxY = std::min(maxY, m_Height);
+		if (minX >= maxX || minY >= maxY) return;
+
+		const int minTileX = minX / TileSize;
+		const int minTileY = minY / TileSize;
+		const int maxTileX = (maxX - 1) / TileSize;
+		const int maxTileY = (maxY - 1) / TileSize;
+
+		for (int tileY = minTileY; tileY <= maxTileY; ++tileY)
+		{
+			for (int tileX = minTileX; tileX <= maxTileX; ++tileX)
+			{
+				const int tileIndex = tileX + tileY * m_TilesWide;
+				std::atomic<TileState>& state = m_pTileStates[tileIndex];
+				if (state.load(std::memory_order_acquire) == TileState::Touched) continue;
+
+				// One thread clears, the others wait for it, a tile is only a few KB
+				TileState expected{ TileState::Pending };
+				if (state.compare_exchange_strong(expected, TileState::Clearing, std::memory_order_acquire))
+				{
+					ClearTile(tileIndex);
+					state.store(TileState::Touched, std::memory_order_release);
+					continue;
+				}
+				while (state.load(std::memory_order_acquire) != TileState::Touched)
+				{
+					std::this_thread::yield();
+				}
+			}
+		}
+	}
+
+	bool FrameBuffer::IsTouched(int x, int y) const
+	{
+		return m_pTileStates[x / TileSize + (y / TileSize) * m_TilesWide].load(std::memory_order_acquire) == TileState::Touched;
+	}
+
+	void FrameBuffer::ResolveColor()
+	{
+		const int tileCount = m_TilesWide * m_TilesHigh;
+
+#pragma omp parallel for
+		for (int tileIndex = 0; tileIndex < tileCount; ++tileIndex)
+		{
+			// An untouched tile is never read again this frame, it is not cleared, only presented as the clear color
+			DetileTile(tileIndex, m_pTileStates[tileIndex].load(std::memory_order_relaxed) == TileState::Touched);
+		}
+	}
+
+	void FrameBuffer::ClearTile(int tileIndex)
+	{
+		// Contiguous, one fill per buffer
+		std::fill_n(m_Color.begin() + size_t(tileIndex) * TileArea, TileArea, m_ClearColor);
+
+		DispatchDepthFormat(m_DepthFormat, [&](auto format)
+			{
+				using Traits = DepthTraits<decltype(format)::value>;
+				std::fill_n(GetDepthPixels<decltype(format)::value>() + size_t(tileIndex) * TileArea, TileArea, Traits::Clear);
+			});
+	}
+
+	void FrameBuffer::DetileTile(int tileIndex, bool isTouched)
+	{
+		const int minX = (tileIndex % m_TilesWide) * TileSize;
+		const int minY = (tileIndex / m_TilesWide) * TileSize;
+		const int rowLength = std::min(TileSize, m_Width - minX);
+		const int rowCount = std::min(TileSize, m_Height - minY);
+		const uint32_t* pTile = m_Color.data() + size_t(tileIndex) * TileArea;
+
+		for (int tileY = 0; tileY < rowCount; ++tileY)
+		{
+			uint32_t* pRow = m_pPresentPixels + size_t(minY + tileY) * m_Width + minX;
+			const uint32_t* pTileRow = pTile + tileY * TileSize;
+
+#if defined(__AVX2__)
+			// A full tile row is 128 bytes, four 8-pixel moves
+			if (rowLength == TileSize)
+			{
+				const __m256i clear = _mm256_set1_epi32(int(m_ClearColor));
+				for (int x = 0; x < TileSize; x += 8)
+				{
+					const __m256i pixels = isTouched ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pTileRow + x)) : clear;
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(pRow + x), pixels);
+				}
+				continue;
+			}
+#endif
+			if (isTouched)
+			{
+				std::copy_n(pTileRow, rowLength, pRow);
+			}
+			else
+			{
+				std::fill_n(pRow, rowLength, m_ClearColor);
+			}
+		}
+	}
+}
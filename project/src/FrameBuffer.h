@@ -0,0 +1,125 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "DepthFormat.h"
+
+namespace dae
+{
+	// Software color and depth targets with a fast clear: clearing only marks the tiles, each tile takes
+	// the clear values the first time a draw touches it, and tiles nothing touched get the clear color at present.
+	// Both are stored tile by tile, a tile's 4 KB of color and of depth are contiguous while it is rasterized,
+	// and the color is only detiled into the row-major present target once the frame is done
+	class FrameBuffer final
+	{
+	public:
+		static constexpr int TileSize{ 32 };
+		static constexpr int TileArea{ TileSize * TileSize };
+
+		// Where a pixel lives in a buffer: row-major, or in TileSize x TileSize tiles stored in row-major order,
+		// each with its pixels in row-major order
+		struct Layout
+		{
+			int width{};
+			int tilesWide{};	// 0 for row-major
+
+			static Layout Linear(int width) { return Layout{ width, 0 }; }
+
+			int GetIndex(int x, int y) const
+			{
+				if (tilesWide == 0) return x + y * width;
+				return ((y / TileSize) * tilesWide + x / TileSize) * TileArea + (y % TileSize) * TileSize + x % TileSize;
+			}
+
+			void GetPixel(int index, int& x, int& y) const
+			{
+				if (tilesWide == 0)
+				{
+					x = index % width;
+					y = index / width;
+					return;
+				}
+				const int tileIndex = index / TileArea;
+				const int tilePixel = index % TileArea;
+				x = (tileIndex % tilesWide) * TileSize + tilePixel % TileSize;
+				y = (tileIndex / tilesWide) * TileSize + tilePixel / TileSize;
+			}
+		};
+
+		// Pixels a tiled buffer of this size stores, the edge tiles are padded to full ones
+		static int GetTiledPixelCount(int width, int height);
+
+		// pPresentPixels is the back buffer's, 32-bit pixels without row padding
+		FrameBuffer(int width, int height, uint32_t* pPresentPixels);
+		~FrameBuffer() = default;
+
+		FrameBuffer(const FrameBuffer&) = delete;
+		FrameBuffer(FrameBuffer&&) noexcept = delete;
+		FrameBuffer& operator=(const FrameBuffer&) = delete;
+		FrameBuffer& operator=(FrameBuffer&&) noexcept = delete;
+
+		int GetWidth() const;
+		int GetHeight() const;
+		// Of the color and the depth pixels
+		Layout GetLayout() const;
+		uint32_t* GetColorPixels();
+		// Before the clear, the present target may change every frame
+		void SetPresentPixels(uint32_t* pPresentPixels);
+
+		// Takes effect with the next clear, the storage always has room for 32 bits per pixel
+		void SetDepthFormat(DepthFormat depthFormat);
+		DepthFormat GetDepthFormat() const;
+		void* GetDepthPixels();
+		const void* GetDepthPixels() const;
+
+		template<DepthFormat Format>
+		typename DepthTraits<Format>::Storage* GetDepthPixels()
+		{
+			return reinterpret_cast<typename DepthTraits<Format>::Storage*>(m_Depth.data());
+		}
+
+		template<DepthFormat Format>
+		const typename DepthTraits<Format>::Storage* GetDepthPixels() const
+		{
+			return reinterpret_cast<const typename DepthTraits<Format>::Storage*>(m_Depth.data());
+		}
+
+		// O(tiles), no pixel is written here, depth clears to the format's clear value
+		void Clear(uint32_t color);
+
+		// Thread-safe, clears the tiles under the pixel rectangle [minX, maxX) x [minY, maxY) that are still pending
+		void Touch(int minX, int minY, int maxX, int maxY);
+
+		// False while the pixel's tile still holds last frame's values, its depth then reads as the clear depth
+		bool IsTouched(int x, int y) const;
+
+		// Detiles the color into the present target, the tiles no draw touched as the clear color.
+		// Call once the frame is drawn and before it is presented
+		void ResolveColor();
+
+	private:
+		enum class TileState : uint8_t
+		{
+			Pending,
+			Clearing,
+			Touched
+		};
+
+		int m_Width{};
+		int m_Height{};
+		int m_TilesWide{};
+		int m_TilesHigh{};
+
+		uint32_t* m_pPresentPixels{};
+		std::vector<uint32_t> m_Color{};
+		DepthFormat m_DepthFormat{ DepthFormat::Float32 };
+		std::vector<uint32_t> m_Depth{};
+		std::unique_ptr<std::atomic<TileState>[]> m_pTileStates{};
+
+		uint32_t m_ClearColor{};
+
+		void ClearTile(int tileIndex);
+		void DetileTile(int tileIndex, bool isTouched);
+	};
+}
@@ -0,0 +1,210 @@
+#include "LightGrid.h"
+#include "Camera.h"
+#include "FrameBuffer.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+
+namespace dae
+{
+	// A light tile never straddles two frame buffer tiles, so one check tells whether its depth was written
+	static_assert(FrameBuffer::TileSize % LightGrid::TileSize == 0);
+
+	void LightGrid::Build(const std::vector<Light>& lights, const Camera& camera, const FrameBuffer& frameBuffer)
+	{
+		const int width = frameBuffer.GetWidth();
+		const int height = frameBuffer.GetHeight();
+		const DepthFormat depthFormat = frameBuffer.GetDepthFormat();
+		const FrameBuffer::Layout layout = frameBuffer.GetLayout();
+
+		m_Width = width;
+		m_Height = height;
+		m_IsCulled = true;
+		m_TilesWide = (width + TileSize - 1) / TileSize;
+		m_TilesHigh = (height + TileSize - 1) / TileSize;
+		m_Tiles.resize(size_t(m_TilesWide) * m_TilesHigh);
+
+		m_Lights = lights;
+		m_Bounds.resize(m_Lights.size());
+		for (size_t i = 0; i < m_Lights.size(); ++i)
+		{
+			m_Bounds[i] = ComputeBounds(m_Lights[i], camera);
+		}
+
+		// Depth buffer values back to view depth: z = f / (f - n) - n * f / ((f - n) * viewDepth)
+		const float nearPlane = camera.nearPlane;
+		const float farPlane = camera.farPlane;
+		const int tileCount = static_cast<int>(m_Tiles.size());
+
+#pragma omp parallel for
+		for (int tileIndex = 0; tileIndex < tileCount; ++tileIndex)
+		{
+			const int tileX = tileIndex % m_TilesWide;
+			const int tileY = tileIndex / m_TilesWide;
+
+			// Untouched tiles are still cleared to the far plane, their depth is not even read
+			float minBufferDepth = FLT_MAX;
+			float maxBufferDepth = 0.f;
+			if (frameBuffer.IsTouched(tileX * TileSize, tileY * TileSize))
+			{
+				DispatchDepthFormat(depthFormat, [&](auto format)
+					{
+						using Traits = DepthTraits<decltype(format)::value>;
+						const typename Traits::Storage* pDepthBuffer = frameBuffer.GetDepthPixels<decltype(format)::value>();
+						for (int py = tileY * TileSize; py < std::min((tileY + 1) * TileSize, height); ++py)
+						{
+							for (int px = tileX * TileSize; px < std::min((tileX + 1) * TileSize, width); ++px)
+							{
+								const float depth = Traits::Decode(pDepthBuffer[layout.GetIndex(px, py)]);
+								if (depth > 1.f) continue;
+								minBufferDepth = std::min(minBufferDepth, depth);
+								maxBufferDepth = std::max(maxBufferDepth, depth);
+							}
+						}
+					});
+			}
+
+			// Tiles without opaque pixels still collect lights for the transparent pass, up to the far plane
+			const bool hasOpaque = minBufferDepth <= maxBufferDepth;
+			const float minDepth = hasOpaque ? nearPlane * farPlane / (farPlane - minBufferDepth * (farPlane - nearPlane)) : farPlane;
+			const float maxDepth = hasOpaque ? nearPlane * farPlane / (farPlane - maxBufferDepth * (farPlane - nearPlane)) : farPlane;
+
+			Tile& tile = m_Tiles[tileIndex];
+			tile.opaqueLights.clear();
+			tile.transparentLights.clear();
+			for (uint32_t i = 0; i < uint32_t(m_Bounds.size()); ++i)
+			{
+				const LightBounds& bounds = m_Bounds[i];
+				if (tileX < bounds.minTileX || tileX > bounds.maxTileX || tileY < bounds.minTileY || tileY > bounds.maxTileY) continue;
+				if (bounds.minDepth > maxDepth) continue;
+
+				tile.transparentLights.push_back(i);
+				if (hasOpaque && bounds.maxDepth >= minDepth) tile.opaqueLights.push_back(i);
+			}
+		}
+	}
+
+	void LightGrid::BuildUnculled(const std::vector<Light>& lights, int width, int height)
+	{
+		m_Width = width;
+		m_Height = height;
+		m_IsCulled = false;
+		m_TilesWide = 1;
+		m_TilesHigh = 1;
+		m_Tiles.resize(1);
+		m_Lights = lights;
+		m_Bounds.clear();
+
+		Tile& tile = m_Tiles[0];
+		tile.opaqueLights.resize(m_Lights.size());
+		for (uint32_t i = 0; i < uint32_t(m_Lights.size()); ++i)
+		{
+			tile.opaqueLights[i] = i;
+		}
+		tile.transparentLights = tile.opaqueLights;
+	}
+
+	int LightGrid::GetTileIndex(int x, int y) const
+	{
+		assert(x >= 0 && x < m_Width && y >= 0 && y < m_Height && "LightGrid::GetTileIndex takes full resolution pixels");
+		if (!m_IsCulled) return 0;
+		return x / TileSize + (y / TileSize) * m_TilesWide;
+	}
+
+	int LightGrid::GetWidth() const
+	{
+		return m_Width;
+	}
+
+	LightGrid::LightRange LightGrid::GetLights(int tileIndex, bool isTransparent) const
+	{
+		const std::vector<uint32_t>& indices = isTransparent ? m_Tiles[tileIndex].transparentLights : m_Tiles[tileIndex].opaqueLights;
+		return { indices.data(), uint32_t(indices.size()) };
+	}
+
+	const Light& LightGrid::GetLight(uint32_t index) const
+	{
+		return m_Lights[index];
+	}
+
+	uint32_t LightGrid::GetLightCount() const
+	{
+		return uint32_t(m_Lights.size());
+	}
+
+	bool LightGrid::GetIncidentLight(const Light& light, const Vector3& position, Vector3& toLight, ColorRGB& radiance)
+	{
+		if (light.type == LightType::Directional)
+		{
+			toLight = -light.direction;
+			radiance = light.color;
+			return true;
+		}
+
+		toLight = light.position - position;
+		const float distanceSquared = toLight.SqrMagnitude();
+		const float rangeSquared = light.range * light.range;
+		if (distanceSquared >= rangeSquared) return false;
+
+		toLight *= InverseSqrt(distanceSquared);
+
+		// Inverse square, windowed so it reaches exactly zero at the range
+		const float window = Square(Saturate(1.f - Square(distanceSquared / rangeSquared)));
+		float falloff = window / (distanceSquared + 1.f);
+
+		if (light.type == LightType::Spot)
+		{
+			const float cosOfAngle = -Vector3::Dot(toLight, light.direction);
+			const float t = Saturate((cosOfAngle - light.outerConeCos) / (light.innerConeCos - light.outerConeCos));
+			falloff *= t * t * (3.f - 2.f * t);
+		}
+
+		if (falloff <= 0.f) return false;
+
+		radiance = light.color * falloff;
+		return true;
+	}
+
+	LightGrid::LightBounds LightGrid::ComputeBounds(const Light& light, const Camera& camera) const
+	{
+		LightBounds bounds{ 0, m_TilesWide - 1, 0, m_TilesHigh - 1, 0.f, FLT_MAX };
+		if (light.type == LightType::Directional) return bounds;
+
+		// Spot lights use the sphere of their range as well, the cone only trims the shading
+		const Vector3 center = camera.viewMatrix.TransformPoint(light.position);
+		const float radius = light.range;
+		bounds.minDepth = center.z - radius;
+		bounds.maxDepth = center.z + radius;
+
+		if (bounds.maxDepth < camera.nearPlane || bounds.minDepth > camera.farPlane)
+		{
+			// Behind the camera or past the far plane, an empty rectangle
+			bounds.minTileX = m_TilesWide;
+			bounds.maxTileX = -1;
+			return bounds;
+		}
+
+		// A sphere crossing the near plane can cover any part of the screen
+		if (bounds.minDepth <= camera.nearPlane) return bounds;
+
+		// x / z over the sphere is bounded by its extremes at the nearest and farthest depth
+		const float xScale = 1.f / (camera.fov * camera.width / camera.height);
+		const float yScale = 1.f / camera.fov;
+		const float minX = std::min((center.x - radius) / bounds.minDepth, (center.x - radius) / bounds.maxDepth) * xScale;
+		const float maxX = std::max((center.x + radius) / bounds.minDepth, (center.x + radius) / bounds.maxDepth) * xScale;
+		const float minY = std::min((center.y - radius) / bounds.minDepth, (center.y - radius) / bounds.maxDepth) * yScale;
+		const float maxY = std::max((center.y + radius) / bounds.minDepth, (center.y + radius) / bounds.maxDepth) * yScale;
+
+		// NDC y points up, screen y points down
+		const float screenMinX = (minX * .5f + .5f) * m_Width;
+		const float screenMaxX = (maxX * .5f + .5f) * m_Width;
+		const float screenMinY = (1.f - maxY) * .5f * m_Height;
+		const float screenMaxY = (1.f - minY) * .5f * m_Height;
+
+		bounds.minTileX = std::max(int(std::floor(screenMinX / TileSize)), 0);
+		bounds.maxTileX = std::min(int(std::floor(screenMaxX / TileSize)), m_TilesWide - 1);
+		bounds.minTileY = std::max(int(std::floor(screenMinY / TileSize)), 0);
+		bounds.maxTileY = std::min(int(std::floor(screenMaxY / TileSize)), m_TilesHigh - 1);
+		return bounds;
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "DataTypes.h"
+
+namespace dae
+{
+	struct Camera;
+	class FrameBuffer;
+
+	// Screen tiles with the lights that can reach them, rebuilt every frame after the depth pre-pass
+	class LightGrid final
+	{
+	public:
+		static constexpr int TileSize{ 16 };
+
+		struct LightRange
+		{
+			const uint32_t* pIndices{};
+			uint32_t count{};
+		};
+
+		LightGrid() = default;
+		~LightGrid() = default;
+
+		LightGrid(const LightGrid&) = delete;
+		LightGrid(LightGrid&&) noexcept = delete;
+		LightGrid& operator=(const LightGrid&) = delete;
+		LightGrid& operator=(LightGrid&&) noexcept = delete;
+
+		// The frame buffer holds the opaque depth of this frame, in any of its depth formats
+		void Build(const std::vector<Light>& lights, const Camera& camera, const FrameBuffer& frameBuffer);
+		// No depth and no culling, one tile over the whole screen with every light in both lists.
+		// For frames whose lights have no range to cull by, or whose shading never reads the tiles
+		void BuildUnculled(const std::vector<Light>& lights, int width, int height);
+
+		// Full resolution pixel coordinates, a draw maps its own pixels to them first
+		int GetTileIndex(int x, int y) const;
+		int GetWidth() const;
+
+		// Transparent surfaces sit in front of the opaque depth, so their list covers everything up to it
+		LightRange GetLights(int tileIndex, bool isTransparent) const;
+		const Light& GetLight(uint32_t index) const;
+		uint32_t GetLightCount() const;
+
+		// Unit vector towards the light and its color scaled by the falloff, false when the light does not reach the point
+		static bool GetIncidentLight(const Light& light, const Vector3& position, Vector3& toLight, ColorRGB& radiance);
+
+	private:
+		// Conservative screen rectangle (in tiles) and view depth range of a light
+		struct LightBounds
+		{
+			int minTileX{};
+			int maxTileX{};
+			int minTileY{};
+			int maxTileY{};
+			float minDepth{};
+			float maxDepth{};
+		};
+
+		struct Tile
+		{
+			std::vector<uint32_t> opaqueLights{};
+			std::vector<uint32_t> transparentLights{};
+		};
+
+		int m_Width{};
+		int m_Height{};
+		int m_TilesWide{};
+		int m_TilesHigh{};
+		bool m_IsCulled{ false };
+
+		std::vector<Light> m_Lights{};
+		std::vector<LightBounds> m_Bounds{};
+		std::vector<Tile> m_Tiles{};
+
+		LightBounds ComputeBounds(const Light& light, const Camera& camera) const;
+	};
+}
@@ -0,0 +1,347 @@
+#include "MaterialTexture.h"
+#include "TextureFilter.h"
+#include <cstring>
+
+namespace dae
+{
+	namespace
+	{
+		SDL_Color FetchScaled(const Texture* pTexture, int x, int y, int width, int height, SDL_Color fallback)
+		{
+			if (pTexture == nullptr) return fallback;
+
+			// Nearest texel when the source map has a different resolution than the packed one
+			return pTexture->FetchTexel(x * pTexture->GetWidth() / width, y * pTexture->GetHeight() / height);
+		}
+
+		// Octahedral mapping keeps any unit normal in two bytes, the sign of z included
+		void EncodeNormal(const Vector3& normal, uint8_t& encodedX, uint8_t& encodedY)
+		{
+			const float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+			float x = normal.x / length;
+			float y = normal.y / length;
+			if (normal.z < 0.f)
+			{
+				const float foldedX = (1.f - std::abs(y)) * (x >= 0.f ? 1.f : -1.f);
+				y = (1.f - std::abs(x)) * (y >= 0.f ? 1.f : -1.f);
+				x = foldedX;
+			}
+
+			encodedX = uint8_t(std::clamp(int(std::round((x * .5f + .5f) * 255.f)), 0, 255));
+			encodedY = uint8_t(std::clamp(int(std::round((y * .5f + .5f) * 255.f)), 0, 255));
+		}
+
+		Vector3 DecodeNormal(uint8_t encodedX, uint8_t encodedY)
+		{
+			const float x = encodedX / 255.f * 2.f - 1.f;
+			const float y = encodedY / 255.f * 2.f - 1.f;
+			Vector3 normal{ x, y, 1.f - std::abs(x) - std::abs(y) };
+			if (normal.z < 0.f)
+			{
+				normal.x = (1.f - std::abs(y)) * (x >= 0.f ? 1.f : -1.f);
+				normal.y = (1.f - std::abs(x)) * (y >= 0.f ? 1.f : -1.f);
+			}
+			return normal.Normalized();
+		}
+
+		// Bytes average directly, the RGB565 specular is averaged per channel and normals as vectors
+		MaterialTexel AverageTexels(const MaterialTexel& texel00, const MaterialTexel& texel10, const MaterialTexel& texel01, const MaterialTexel& texel11)
+		{
+			int channels[9]{};
+			Vector3 normal{};
+			for (const MaterialTexel* pTexel : { &texel00, &texel10, &texel01, &texel11 })
+			{
+				channels[0] += pTexel->diffuseR;
+				channels[1] += pTexel->diffuseG;
+				channels[2] += pTexel->diffuseB;
+				channels[3] += pTexel->gloss;
+				normal += DecodeNormal(pTexel->normalX, pTexel->normalY);
+				channels[6] += pTexel->specular >> 11;
+				channels[7] += (pTexel->specular >> 5) & 63;
+				channels[8] += pTexel->specular & 31;
+			}
+
+			MaterialTexel result;
+			result.diffuseR = uint8_t((channels[0] + 2) / 4);
+			result.diffuseG = uint8_t((channels[1] + 2) / 4);
+			result.diffuseB = uint8_t((channels[2] + 2) / 4);
+			result.gloss = uint8_t((channels[3] + 2) / 4);
+			EncodeNormal(normal.SqrMagnitude() > 0.f ? normal : Vector3::UnitZ, result.normalX, result.normalY);
+			result.specular = uint16_t(((channels[6] + 2) / 4) << 11 | ((channels[7] + 2) / 4) << 5 | ((channels[8] + 2) / 4));
+			return result;
+		}
+
+		MaterialSample Unpack(const MaterialTexel& texel, bool decodeNormal = true)
+		{
+			MaterialSample sample;
+			sample.diffuse = { texel.diffuseR / 255.f, texel.diffuseG / 255.f, texel.diffuseB / 255.f };
+			sample.gloss = texel.gloss / 255.f;
+
+			sample.specular = {
+				float(texel.specular >> 11) / 31.f,
+				float((texel.specular >> 5) & 63) / 63.f,
+				float(texel.specular & 31) / 31.f };
+
+			if (decodeNormal) sample.normal = DecodeNormal(texel.normalX, texel.normalY);
+
+			return sample;
+		}
+	}
+
+	MaterialTexture::MaterialTexture(int width, int height, std::vector<MaterialTexel>&& texels) :
+		m_Width(width),
+		m_Height(height)
+	{
+		m_Mips.push_back(std::move(texels));
+		BuildMips();
+	}
+
+	void MaterialTexture::BuildMips()
+	{
+		m_Mips.resize(1);
+
+		int mipWidth{ m_Width };
+		int mipHeight{ m_Height };
+		while (mipWidth > 1 || mipHeight > 1)
+		{
+			const int nextWidth = std::max(mipWidth / 2, 1);
+			const int nextHeight = std::max(mipHeight / 2, 1);
+			const std::vector<MaterialTexel>& source = m_Mips.back();
+			std::vector<MaterialTexel> next(size_t(nextWidth) * nextHeight);
+
+			for (int y = 0; y < nextHeight; ++y)
+			{
+				const int y0 = std::min(y * 2, mipHeight - 1);
+				const int y1 = std::min(y * 2 + 1, mipHeight - 1);
+				for (int x = 0; x < nextWidth; ++x)
+				{
+					const int x0 = std::min(x * 2, mipWidth - 1);
+					const int x1 = std::min(x * 2 + 1, mipWidth - 1);
+					next[size_t(y) * nextWidth + x] = AverageTexels(source[size_t(y0) * mipWidth + x0], source[size_t(y0) * mipWidth + x1],
+						source[size_t(y1) * mipWidth + x0], source[size_t(y1) * mipWidth + x1]);
+				}
+			}
+
+			m_Mips.push_back(std::move(next));
+			mipWidth = nextWidth;
+			mipHeight = nextHeight;
+		}
+	}
+
+	std::unique_ptr<MaterialTexture> MaterialTexture::Pack(const Texture* pDiffuse, const Texture* pNormal, const Texture* pSpecular, const Texture* pGlossiness)
+	{
+		int width{ 1 };
+		int height{ 1 };
+		for (const Texture* pTexture : { pDiffuse, pNormal, pSpecular, pGlossiness })
+		{
+			if (pTexture == nullptr) continue;
+			width = std::max(width, pTexture->GetWidth());
+			height = std::max(height, pTexture->GetHeight());
+		}
+
+		constexpr SDL_Color black{ 0, 0, 0, 255 };
+		constexpr SDL_Color flatNormal{ 128, 128, 255, 255 };
+
+		std::vector<MaterialTexel> texels(size_t(width) * height);
+
+#pragma omp parallel for
+		for (int y = 0; y < height; ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				const SDL_Color diffuse = FetchScaled(pDiffuse, x, y, width, height, black);
+				const SDL_Color normal = FetchScaled(pNormal, x, y, width, height, flatNormal);
+				const SDL_Color specular = FetchScaled(pSpecular, x, y, width, height, black);
+				const SDL_Color gloss = FetchScaled(pGlossiness, x, y, width, height, black);
+
+				MaterialTexel& texel = texels[size_t(y) * width + x];
+				texel.diffuseR = diffuse.r;
+				texel.diffuseG = diffuse.g;
+				texel.diffuseB = diffuse.b;
+				texel.gloss = gloss.r;
+
+				// Tangent-space normals always point out of the surface, so z is rebuilt from x and y
+				const float normalX = 2.f * normal.r / 255.f - 1.f;
+				const float normalY = 2.f * normal.g / 255.f - 1.f;
+				EncodeNormal({ normalX, normalY, sqrtf(std::max(0.f, 1.f - normalX * normalX - normalY * normalY)) }, texel.normalX, texel.normalY);
+				texel.specular = uint16_t(((specular.r * 31 + 127) / 255) << 11 | ((specular.g * 63 + 127) / 255) << 5 | ((specular.b * 31 + 127) / 255));
+			}
+		}
+
+		return std::make_unique<MaterialTexture>(width, height, std::move(texels));
+	}
+
+	MaterialSample MaterialTexture::Sample(const Vector2& uv) const
+	{
+		return Unpack(FetchTexel(static_cast<int>(uv.x * m_Width), static_cast<int>(uv.y * m_Height)));
+	}
+
+	MaterialSample MaterialTexture::Sample(const Vector2& uv, const Vector2& uvDdx, const Vector2& uvDdy, FilteringTechnique filter) const
+	{
+		auto fetch = [this](int x, int y, int mip) { return Unpack(FetchTexel(x, y, mip)); };
+
+		return TextureFilter::Sample<MaterialSample>(fetch, m_Width, m_Height, GetMipCount(), uv, uvDdx, uvDdy, filter);
+	}
+
+	MaterialSample MaterialTexture::Sample(const Vector2& uv, const TextureFilter::Footprint& footprint, FilteringTechnique filter, bool decodeNormal) const
+	{
+		auto fetch = [this, decodeNormal](int x, int y, int mip) { return Unpack(FetchTexel(x, y, mip), decodeNormal); };
+
+		return TextureFilter::Sample<MaterialSample>(fetch, m_Width, m_Height, GetMipCount(), uv, footprint, filter);
+	}
+
+	void MaterialTexture::BakeObjectSpaceNormals(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+	{
+		if (m_IsObjectSpace || m_pUVirtualTexture) return;
+
+		std::vector<MaterialTexel>& texels = m_Mips.front();
+		std::vector<uint8_t> isCovered(texels.size(), 0);
+		std::vector<MaterialTexel> baked = texels;
+
+		// Rasterize every triangle in uv space, texel centers match Sample's uv * size convention
+		for (size_t index = 0; index + 2 < indices.size(); index += 3)
+		{
+			const Vertex& vertex0 = vertices[indices[index]];
+			const Vertex& vertex1 = vertices[indices[index + 1]];
+			const Vertex& vertex2 = vertices[indices[index + 2]];
+
+			const Vector2 p0{ vertex0.uv.x * m_Width, vertex0.uv.y * m_Height };
+			const Vector2 p1{ vertex1.uv.x * m_Width, vertex1.uv.y * m_Height };
+			const Vector2 p2{ vertex2.uv.x * m_Width, vertex2.uv.y * m_Height };
+
+			const float area = Vector2::Cross(p1 - p0, p2 - p0);
+			if (std::abs(area) < 1e-8f) continue;
+
+			const int minX = std::max(0, int(std::floor(std::min({ p0.x, p1.x, p2.x }))));
+			const int maxX = std::min(m_Width - 1, int(std::ceil(std::max({ p0.x, p1.x, p2.x }))));
+			const int minY = std::max(0, int(std::floor(std::min({ p0.y, p1.y, p2.y }))));
+			const int maxY = std::min(m_Height - 1, int(std::ceil(std::max({ p0.y, p1.y, p2.y }))));
+
+#pragma omp parallel for
+			for (int y = minY; y <= maxY; ++y)
+			{
+				for (int x = minX; x <= maxX; ++x)
+				{
+					const Vector2 p{ x + .5f, y + .5f };
+					const float weight0 = Vector2::Cross(p1 - p, p2 - p) / area;
+					const float weight1 = Vector2::Cross(p2 - p, p0 - p) / area;
+					const float weight2 = 1.f - weight0 - weight1;
+					if (weight0 < 0.f || weight1 < 0.f || weight2 < 0.f) continue;
+
+					// Same frame the shader used: binormal = normal x tangent
+					const Vector3 normal = (vertex0.normal * weight0 + vertex1.normal * weight1 + vertex2.normal * weight2).Normalized();
+					const Vector3 tangent = Vector3::Reject(vertex0.tangent * weight0 + vertex1.tangent * weight1 + vertex2.tangent * weight2, normal).Normalized();
+					const Vector3 binormal = Vector3::Cross(normal, tangent);
+
+					const size_t texelIndex = size_t(y) * m_Width + x;
+					const Vector3 tangentNormal = DecodeNormal(texels[texelIndex].normalX, texels[texelIndex].normalY);
+					const Vector3 objectNormal = (tangent * tangentNormal.x + binormal * tangentNormal.y + normal * tangentNormal.z).Normalized();
+
+					EncodeNormal(objectNormal, baked[texelIndex].normalX, baked[texelIndex].normalY);
+					isCovered[texelIndex] = 1;
+				}
+			}
+		}
+
+		// Grow the islands into the gutters so filtering and mips near uv seams never read tangent-space texels
+		constexpr int dilationPasses{ 8 };
+		for (int pass = 0; pass < dilationPasses; ++pass)
+		{
+			std::vector<uint8_t> wasCovered = isCovered;
+#pragma omp parallel for
+			for (int y = 0; y < m_Height; ++y)
+			{
+				for (int x = 0; x < m_Width; ++x)
+				{
+					const size_t texelIndex = size_t(y) * m_Width + x;
+					if (wasCovered[texelIndex]) continue;
+
+					for (const auto& [offsetX, offsetY] : { std::pair{ -1, 0 }, std::pair{ 1, 0 }, std::pair{ 0, -1 }, std::pair{ 0, 1 } })
+					{
+						const int neighborX = x + offsetX;
+						const int neighborY = y + offsetY;
+						if (neighborX < 0 || neighborX >= m_Width || neighborY < 0 || neighborY >= m_Height) continue;
+
+						const size_t neighborIndex = size_t(neighborY) * m_Width + neighborX;
+						if (!wasCovered[neighborIndex]) continue;
+
+						baked[texelIndex].normalX = baked[neighborIndex].normalX;
+						baked[texelIndex].normalY = baked[neighborIndex].normalY;
+						isCovered[texelIndex] = 1;
+						break;
+					}
+				}
+			}
+		}
+
+		texels = std::move(baked);
+		m_IsObjectSpace = true;
+		BuildMips();
+	}
+
+	bool MaterialTexture::IsObjectSpace() const
+	{
+		return m_IsObjectSpace;
+	}
+
+	void MaterialTexture::Virtualize(PageCache* pCache)
+	{
+		if (m_pUVirtualTexture) return;
+
+		std::vector<VirtualTexture::LevelFormat> levels{};
+		for (int mip = 0; mip < int(m_Mips.size()); ++mip)
+		{
+			levels.push_back({ TextureFilter::GetMipSize(m_Width, mip), TextureFilter::GetMipSize(m_Height, mip), 1, int(sizeof(MaterialTexel)) });
+		}
+
+		// Each mip is paged straight from m_Mips and dropped once the next one is asked for
+		m_pUVirtualTexture = std::make_unique<VirtualTexture>(pCache, levels, [this](int mip, size_t& pitch)
+			{
+				if (mip > 0) std::vector<MaterialTexel>().swap(m_Mips[mip - 1]);
+
+				pitch = size_t(TextureFilter::GetMipSize(m_Width, mip)) * sizeof(MaterialTexel);
+				return reinterpret_cast<const uint8_t*>(m_Mips[mip].data());
+			});
+
+		std::vector<std::vector<MaterialTexel>>().swap(m_Mips);
+	}
+
+	bool MaterialTexture::IsVirtual() const
+	{
+		return m_pUVirtualTexture != nullptr;
+	}
+
+	int MaterialTexture::GetWidth() const
+	{
+		return m_Width;
+	}
+
+	int MaterialTexture::GetHeight() const
+	{
+		return m_Height;
+	}
+
+	int MaterialTexture::GetMipCount() const
+	{
+		if (m_pUVirtualTexture) return m_pUVirtualTexture->GetMipCount();
+		return int(m_Mips.size());
+	}
+
+	MaterialTexel MaterialTexture::FetchTexel(int x, int y, int mip) const
+	{
+		MaterialTexel texel;
+		if (m_pUVirtualTexture)
+		{
+			memcpy(&texel, m_pUVirtualTexture->FetchTexel(x, y, mip), sizeof(MaterialTexel));
+			return texel;
+		}
+
+		mip = std::clamp(mip, 0, int(m_Mips.size()) - 1);
+		const int mipWidth = TextureFilter::GetMipSize(m_Width, mip);
+		const int mipHeight = TextureFilter::GetMipSize(m_Height, mip);
+		x = std::clamp(x, 0, mipWidth - 1);
+		y = std::clamp(y, 0, mipHeight - 1);
+
+		return m_Mips[mip][size_t(y) * mipWidth + x];
+	}
+}
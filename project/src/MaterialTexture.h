@@ -0,0 +1,87 @@
+#pragma once
+#include "pch.h"
+#include "Texture.h"
+#include "DataTypes.h"
+#include "TextureFilter.h"
+
+namespace dae
+{
+	// One interleaved texel holding everything PixelShading needs (8 bytes)
+	struct MaterialTexel
+	{
+		uint8_t diffuseR;
+		uint8_t diffuseG;
+		uint8_t diffuseB;
+		uint8_t gloss;
+		uint8_t normalX;	// octahedral-encoded unit normal, tangent-space until baked to object space
+		uint8_t normalY;
+		uint16_t specular;	// RGB565
+	};
+	static_assert(sizeof(MaterialTexel) == 8, "MaterialTexel must stay 8 bytes");
+
+	struct MaterialSample
+	{
+		ColorRGB diffuse{};
+		Vector3 normal{};	// tangent- or object-space, see MaterialTexture::IsObjectSpace
+		ColorRGB specular{};
+		float gloss{};
+
+		// Weighted sums for the filtered samplers
+		MaterialSample& operator*=(float s)
+		{
+			diffuse *= s;
+			normal *= s;
+			specular *= s;
+			gloss *= s;
+			return *this;
+		}
+
+		MaterialSample& operator+=(const MaterialSample& other)
+		{
+			diffuse += other.diffuse;
+			normal += other.normal;
+			specular += other.specular;
+			gloss += other.gloss;
+			return *this;
+		}
+	};
+
+	class MaterialTexture final
+	{
+	public:
+		MaterialTexture(int width, int height, std::vector<MaterialTexel>&& texels);
+
+		// Packs the four vehicle maps into one texel stream, the maps can be nullptr
+		static std::unique_ptr<MaterialTexture> Pack(const Texture* pDiffuse, const Texture* pNormal, const Texture* pSpecular, const Texture* pGlossiness);
+
+		MaterialSample Sample(const Vector2& uv) const;
+
+		// Filtered sample matching the D3D11 samplers, the uv derivatives are per screen pixel
+		MaterialSample Sample(const Vector2& uv, const Vector2& uvDdx, const Vector2& uvDdy, FilteringTechnique filter) const;
+		// decodeNormal = false leaves the normal zero and skips its per-texel decode, for shading tiers that do not use it
+		MaterialSample Sample(const Vector2& uv, const TextureFilter::Footprint& footprint, FilteringTechnique filter, bool decodeNormal = true) const;
+
+		// Rewrites the normals in the object space of the given mesh so shading needs no tangent frame.
+		// Only valid for rigid meshes whose uv islands do not overlap, and only before Virtualize
+		void BakeObjectSpaceNormals(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+		bool IsObjectSpace() const;
+
+		// Moves the texel stream into pages managed by the cache
+		void Virtualize(PageCache* pCache);
+		bool IsVirtual() const;
+
+		int GetWidth() const;
+		int GetHeight() const;
+		int GetMipCount() const;
+		MaterialTexel FetchTexel(int x, int y, int mip = 0) const;
+
+	private:
+		int m_Width{};
+		int m_Height{};
+		std::vector<std::vector<MaterialTexel>> m_Mips{};	// full chain down to 1x1, level 0 first
+		bool m_IsObjectSpace{ false };
+		std::unique_ptr<VirtualTexture> m_pUVirtualTexture{};
+
+		void BuildMips();
+	};
+}
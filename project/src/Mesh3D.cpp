@@ -1,7 +1,14 @@
 #include "Mesh3D.h"
 #include "Camera.h"
 #include "Texture.h"
+#include <cassert>
 #include <memory.h>
+#include <array>
+#include <thread>
+#include <utility>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 constexpr float eps = float( 1e-4);
 Mesh3D::Mesh3D(ID3D11Device* pDevice, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, Effect* pEffect, bool toApplyTransparency) : m_pEffect(pEffect), m_ToApplyTransparency(toApplyTransparency)
 {
@@ -127,201 +134,813 @@ void Mesh3D::RenderGPU(const Vector3& cameraPosition, const Matrix& pWorldMatrix
 	}
 }
 
-void Mesh3D::RenderCPU(int width, int height, ShadingMode shadingMode, DisplayMode displayMode, CullingMode cullingMode, const Camera& camera, bool isNormalMap, SDL_Surface* pBackBuffer, uint32_t* pBackBufferPixels, float* pDepthBufferPixels) const
+namespace
 {
-	bool isTriangleList = m_pUMesh->primitiveTopology == PrimitiveTopology::TriangleStrip;
-	// Parallelize over triangles
-#pragma omp parallel for
-	for (int inx = 0; inx < m_pUMesh->indices.size(); inx += (isTriangleList ? 3 : 1)) {
+	// Row shader for kernels that finish each pixel on the spot
+	template<typename PixelFunction>
+	struct PixelRowShader
+	{
+		PixelFunction shade;
+
+		void Shade(int pixelIndex, Vertex_Out& pixelVertex, const Vector2& uvDdx, const Vector2& uvDdy)
+		{
+			shade(pixelIndex, pixelVertex, uvDdx, uvDdy);
+		}
 
-		auto t0 = m_pUMesh->indices[inx];
-		auto t1 = m_pUMesh->indices[inx + 1];
-		auto t2 = m_pUMesh->indices[inx + 2];
+		void Flush() {}
+	};
 
-		////Perform clipping 
-		//std::vector<Vertex_Out> clippedVertices;
-		//std::vector<uint32_t> clippedIndices;
-		//ClipTriangle(mesh.vertices_out[t0], mesh.vertices_out[t1], mesh.vertices_out[t2], clippedVertices, clippedIndices);
-		//
-		//if (clippedVertices.size() < 3) continue; // If there are not enough vertices left after clipping, skip this triangle
+	template<typename PixelFunction>
+	PixelRowShader(PixelFunction) -> PixelRowShader<PixelFunction>;
 
-		// Skip degenerate triangles
-		if (t0 == t1 || t1 == t2 || t2 == t0) continue;
+	// ShadeColor(pixelIndex, vertex, uvDdx, uvDdy) returns the pixel's color, the row stores them packed 8 at a time
+	template<typename ColorFunction>
+	struct ColorRowShader
+	{
+		static constexpr int Lanes{ 8 };
 
-		// Vertex positions
-		auto v0 = m_pUMesh->vertices_out[t0].position;
-		auto v1 = m_pUMesh->vertices_out[t1].position;
-		auto v2 = m_pUMesh->vertices_out[t2].position;
+		const PixelFormat* pFormat{};
+		uint32_t* pPixels{};
+		ColorFunction shadeColor;
 
-		// Skip if any vertex is behind the camera (w < 0)
-		if (v0.w < 0 || v1.w < 0 || v2.w < 0) continue;
+		int count{};
+		int pixelIndex[Lanes]{};
+		alignas(32) float r[Lanes]{};
+		alignas(32) float g[Lanes]{};
+		alignas(32) float b[Lanes]{};
 
-		if (!CheckClipping(v0, v1, v2))
+		void Shade(int index, Vertex_Out& pixelVertex, const Vector2& uvDdx, const Vector2& uvDdy)
 		{
-			continue; // All vertices are outside the clip space, skip rendering
+			const ColorRGB color = shadeColor(index, pixelVertex, uvDdx, uvDdy);
+			pixelIndex[count] = index;
+			r[count] = color.r;
+			g[count] = color.g;
+			b[count] = color.b;
+			if (++count == Lanes) Flush();
 		}
 
-		ConvertToScreenSpace(float(width), float(height), v0, v1, v2);
+		void Flush()
+		{
+#if defined(__AVX2__)
+			if (pFormat->isPacked)
+			{
+				alignas(32) uint32_t packed[Lanes];
+				_mm256_store_si256(reinterpret_cast<__m256i*>(packed), pFormat->Pack8(_mm256_load_ps(r), _mm256_load_ps(g), _mm256_load_ps(b)));
+				for (int lane = 0; lane < count; ++lane)
+				{
+					pPixels[pixelIndex[lane]] = packed[lane];
+				}
+				count = 0;
+				return;
+			}
+#endif
+			for (int lane = 0; lane < count; ++lane)
+			{
+				pPixels[pixelIndex[lane]] = pFormat->Pack(ColorRGB{ r[lane], g[lane], b[lane] });
+			}
+			count = 0;
+		}
+	};
+
+	template<typename ColorFunction>
+	ColorRowShader(const PixelFormat*, uint32_t*, ColorFunction) -> ColorRowShader<ColorFunction>;
+
+	struct NullRowShader
+	{
+		void Shade(int, Vertex_Out&, const Vector2&, const Vector2&) {}
+		void Flush() {}
+	};
+}
+
+// Builds the kernel tables, indices decode back into the template parameters
+struct Mesh3D::KernelTable
+{
+	// index = material + 2 * (cull + 3 * (blend + 2 * (normalMap + 2 * shadingMode)))
+	template<size_t Index>
+	static constexpr Kernel GetShadingKernel()
+	{
+		constexpr bool useMaterial = Index % 2 == 1;
+		constexpr CullingMode cull = CullingMode((Index / 2) % 3);
+		constexpr bool blend = (Index / 6) % 2 == 1;
+		constexpr bool normalMap = (Index / 12) % 2 == 1;
+		constexpr ShadingMode shadingMode = ShadingMode(Index / 24);
+
+		// RenderCPU never picks these, so they are not instantiated: normal maps need a material and per pixel
+		// lighting, and meshes that cannot use a shading cache fall back from Decoupled to Combined
+		if constexpr (normalMap && (!useMaterial || shadingMode == ShadingMode::Gouraud)) return nullptr;
+		else if constexpr (shadingMode == ShadingMode::Decoupled && (blend || !useMaterial)) return nullptr;
+		else return &Mesh3D::RenderShaded<shadingMode, normalMap, blend, cull, useMaterial>;
+	}
+
+	// index = depthWrite + 2 * cull
+	template<size_t Index>
+	static constexpr Kernel GetDepthKernel()
+	{
+		return &Mesh3D::RenderDepth<CullingMode(Index / 2), Index % 2 == 1>;
+	}
+
+	// index = cull
+	template<size_t Index>
+	static constexpr Kernel GetPrepassKernel()
+	{
+		return &Mesh3D::RenderDepthPrepass<CullingMode(Index)>;
+	}
 
-		// Compute bounding box of the triangle
-		int minX = std::max(0, static_cast<int>(std::floor(std::min({ v0.x, v1.x, v2.x }))));
-		int maxX = std::min(width, static_cast<int>(std::ceil(std::max({ v0.x, v1.x, v2.x }))));
-		int minY = std::max(0, static_cast<int>(std::floor(std::min({ v0.y, v1.y, v2.y }))));
-		int maxY = std::min(height, static_cast<int>(std::ceil(std::max({ v0.y, v1.y, v2.y }))));
+	template<size_t... Indices>
+	static constexpr std::array<Kernel, sizeof...(Indices)> MakeShadingKernels(std::index_sequence<Indices...>)
+	{
+		return { GetShadingKernel<Indices>()... };
+	}
 
-		if (displayMode == DisplayMode::BoundingBox)
+	template<size_t... Indices>
+	static constexpr std::array<Kernel, sizeof...(Indices)> MakeDepthKernels(std::index_sequence<Indices...>)
+	{
+		return { GetDepthKernel<Indices>()... };
+	}
+
+	template<size_t... Indices>
+	static constexpr std::array<Kernel, sizeof...(Indices)> MakePrepassKernels(std::index_sequence<Indices...>)
+	{
+		return { GetPrepassKernel<Indices>()... };
+	}
+
+	static constexpr size_t shadingKernelCount{ 6 * 2 * 2 * 3 * 2 };
+	static constexpr size_t depthKernelCount{ 3 * 2 };
+	static constexpr size_t prepassKernelCount{ 3 };
+
+	static const std::array<Kernel, shadingKernelCount> shadingKernels;
+	static const std::array<Kernel, depthKernelCount> depthKernels;
+	static const std::array<Kernel, prepassKernelCount> prepassKernels;
+};
+
+const std::array<Mesh3D::Kernel, Mesh3D::KernelTable::shadingKernelCount> Mesh3D::KernelTable::shadingKernels = MakeShadingKernels(std::make_index_sequence<shadingKernelCount>{});
+const std::array<Mesh3D::Kernel, Mesh3D::KernelTable::depthKernelCount> Mesh3D::KernelTable::depthKernels = MakeDepthKernels(std::make_index_sequence<depthKernelCount>{});
+const std::array<Mesh3D::Kernel, Mesh3D::KernelTable::prepassKernelCount> Mesh3D::KernelTable::prepassKernels = MakePrepassKernels(std::make_index_sequence<prepassKernelCount>{});
+
+void Mesh3D::RenderCPU(int width, int height, ShadingMode shadingMode, DisplayMode displayMode, CullingMode cullingMode, const Camera& camera, const LightGrid& lightGrid, bool isNormalMap, FilteringTechnique filteringTechnique, SDL_Surface* pBackBuffer, const PixelFormat& backBufferFormat, uint32_t* pBackBufferPixels, void* pDepthBuffer, DepthFormat depthFormat, FrameBuffer* pFrameBuffer, TransparencyBuffer* pTransparencyBuffer) const
+{
+	// Everything the kernels read is resolved once per draw, the pixel loop makes no virtual calls
+	DrawContext context{};
+	context.width = width;
+	context.height = height;
+	context.filteringTechnique = filteringTechnique;
+	context.pBackBuffer = pBackBuffer;
+	context.backBufferFormat = backBufferFormat;
+	context.pBackBufferPixels = pBackBufferPixels;
+	context.pDepthBuffer = pDepthBuffer;
+	context.layout = pFrameBuffer != nullptr ? pFrameBuffer->GetLayout() : FrameBuffer::Layout::Linear(width);
+	context.depthFormat = depthFormat;
+	context.nearPlane = camera.nearPlane;
+	context.farPlane = camera.farPlane;
+	context.pFrameBuffer = pFrameBuffer;
+	context.pTransparencyBuffer = pTransparencyBuffer;
+	context.pMaterial = m_pEffect->GetMaterial();
+	// A material replaces the maps on the CPU, their CPU copies are released once it is packed
+	if (context.pMaterial == nullptr)
+	{
+		context.pDiffuseTexture = m_pEffect->GetDiffuseTexture();
+		context.pSpecularTexture = m_pEffect->GetSpecularTexture();
+		context.pGlossinessTexture = m_pEffect->GetGlossinessTexture();
+	}
+	context.pLightGrid = &lightGrid;
+	context.lightGridScale = std::max((lightGrid.GetWidth() + width - 1) / width, 1);
+
+	// Shading runs in object space, which is only valid because the world matrix is rigid
+	const Matrix worldToObject = Matrix::Inverse(m_ObjectToWorld);
+	std::vector<Light>& objectLights = m_ObjectLights;
+	objectLights.resize(lightGrid.GetLightCount());
+	for (uint32_t i = 0; i < lightGrid.GetLightCount(); ++i)
+	{
+		objectLights[i] = lightGrid.GetLight(i);
+		objectLights[i].position = worldToObject.TransformPoint(objectLights[i].position);
+		objectLights[i].direction = worldToObject.TransformVector(objectLights[i].direction).Normalized();
+	}
+	context.pLights = objectLights.data();
+
+	const bool useMaterial = context.pMaterial != nullptr;
+	// Only baked object-space normals are supported, tangent-space maps would need the tangent varying back
+	const bool normalMap = isNormalMap && useMaterial && context.pMaterial->IsObjectSpace() && shadingMode != ShadingMode::Gouraud;
+	const bool blend = m_ToApplyTransparency;
+	// Blended layers test depth without writing it, the shading kernels derive this from blend themselves
+	const bool depthWrite = !blend;
+
+	// Meshes without a cache, the fire among them, shade Decoupled as Combined
+	if (shadingMode == ShadingMode::Decoupled && (!m_pUShadingCache || blend || !useMaterial)) shadingMode = ShadingMode::Combined;
+	context.pShadingCache = m_pUShadingCache.get();
+
+	switch (displayMode)
+	{
+	case DisplayMode::BoundingBox:
+		RenderBoundingBoxes(context);
+		break;
+	case DisplayMode::DepthBuffer:
+		(this->*KernelTable::depthKernels[size_t(depthWrite) + 2 * size_t(cullingMode)])(context);
+		break;
+	case DisplayMode::ShadingMode:
+	{
+		// The blended fire stays unlit in Gouraud, as in Combined
+		if (shadingMode == ShadingMode::Gouraud && !blend) LightVertices(context);
+		if (shadingMode == ShadingMode::Decoupled) UpdateShadingCache(context, normalMap);
+
+		const size_t index = size_t(useMaterial) + 2 * (size_t(cullingMode) + 3 * (size_t(blend) + 2 * (size_t(normalMap) + 2 * size_t(shadingMode))));
+		const Kernel kernel = KernelTable::shadingKernels[index];
+		assert(kernel != nullptr && "The flags above never select an uninstantiated kernel");
+		(this->*kernel)(context);
+		break;
+	}
+	}
+}
+
+void Mesh3D::RenderDepthPrepassCPU(CullingMode cullingMode, const Camera& camera, FrameBuffer& frameBuffer) const
+{
+	DrawContext context{};
+	context.width = frameBuffer.GetWidth();
+	context.height = frameBuffer.GetHeight();
+	context.pDepthBuffer = frameBuffer.GetDepthPixels();
+	context.layout = frameBuffer.GetLayout();
+	context.depthFormat = frameBuffer.GetDepthFormat();
+	context.nearPlane = camera.nearPlane;
+	context.farPlane = camera.farPlane;
+	context.pFrameBuffer = &frameBuffer;
+
+	(this->*KernelTable::prepassKernels[size_t(cullingMode)])(context);
+}
+
+bool Mesh3D::SetupTriangle(const DrawContext& context, int firstIndex, TriangleSetup& triangle) const
+{
+	triangle.t0 = m_pUMesh->indices[firstIndex];
+	triangle.t1 = m_pUMesh->indices[firstIndex + 1];
+	triangle.t2 = m_pUMesh->indices[firstIndex + 2];
+
+	// Skip degenerate triangles
+	if (triangle.t0 == triangle.t1 || triangle.t1 == triangle.t2 || triangle.t2 == triangle.t0) return false;
+
+	// Vertex positions
+	triangle.v0 = m_pUMesh->vertices_out[triangle.t0].position;
+	triangle.v1 = m_pUMesh->vertices_out[triangle.t1].position;
+	triangle.v2 = m_pUMesh->vertices_out[triangle.t2].position;
+
+	// Skip if any vertex is behind the camera (w < 0)
+	if (triangle.v0.w < 0 || triangle.v1.w < 0 || triangle.v2.w < 0) return false;
+
+	// All vertices are outside the clip space, skip rendering
+	if (!CheckClipping(triangle.v0, triangle.v1, triangle.v2)) return false;
+
+	ConvertToScreenSpace(float(context.width), float(context.height), triangle.v0, triangle.v1, triangle.v2);
+
+	// Compute bounding box of the triangle
+	triangle.minX = std::max(0, static_cast<int>(std::floor(std::min({ triangle.v0.x, triangle.v1.x, triangle.v2.x }))));
+	triangle.maxX = std::min(context.width, static_cast<int>(std::ceil(std::max({ triangle.v0.x, triangle.v1.x, triangle.v2.x }))));
+	triangle.minY = std::max(0, static_cast<int>(std::floor(std::min({ triangle.v0.y, triangle.v1.y, triangle.v2.y }))));
+	triangle.maxY = std::min(context.height, static_cast<int>(std::ceil(std::max({ triangle.v0.y, triangle.v1.y, triangle.v2.y }))));
+
+	return true;
+}
+
+void Mesh3D::RenderBoundingBoxes(const DrawContext& context) const
+{
+	const int indexStep = m_pUMesh->primitiveTopology == PrimitiveTopology::TriangleStrip ? 3 : 1;
+	const int indexCount = static_cast<int>(m_pUMesh->indices.size());
+	const Uint32 color = context.backBufferFormat.Pack(ColorRGB{ 1.f, 1.f, 1.f });
+
+#pragma omp parallel for
+	for (int inx = 0; inx < indexCount; inx += indexStep)
+	{
+		TriangleSetup triangle;
+		if (!SetupTriangle(context, inx, triangle)) continue;
+
+		if (context.pFrameBuffer != nullptr) context.pFrameBuffer->Touch(triangle.minX, triangle.minY, triangle.maxX, triangle.maxY);
+
+		// Through the layout, the back buffer pixels may be tiled
+		for (int py = triangle.minY; py < triangle.maxY; ++py)
 		{
-			Uint32 color = SDL_MapRGB(pBackBuffer->format, 255, 255, 255);
-			SDL_Rect rect;
-			rect.x = minX;
-			rect.y = minY;
-			rect.w = maxX - minX;
-			rect.h = maxY - minY;
-			SDL_FillRect(pBackBuffer, &rect, color);
+			for (int px = triangle.minX; px < triangle.maxX; ++px)
+			{
+				context.pBackBufferPixels[context.layout.GetIndex(px, py)] = color;
+			}
 		}
-		else
+	}
+}
+
+template<CullingMode Cull, bool DepthWrite, Mesh3D::Varyings Interpolated, typename MakeRowShader>
+void Mesh3D::Rasterize(const DrawContext& context, const MakeRowShader& makeRowShader) const
+{
+	DispatchDepthFormat(context.depthFormat, [&](auto format)
 		{
-			// Edge vectors for barycentric coordinates
-			auto e0 = v2 - v1;
-			auto e1 = v0 - v2;
-			auto e2 = v1 - v0;
+			RasterizeWithDepth<decltype(format)::value, Cull, DepthWrite, Interpolated>(context, makeRowShader);
+		});
+}
 
-			Vector2 edge0_2D(e0.x, e0.y);
-			Vector2 edge1_2D(e1.x, e1.y);
-			Vector2 edge2_2D(e2.x, e2.y);
+template<DepthFormat Format, CullingMode Cull, bool DepthWrite, Mesh3D::Varyings Interpolated, typename MakeRowShader>
+void Mesh3D::RasterizeWithDepth(const DrawContext& context, const MakeRowShader& makeRowShader) const
+{
+	const int indexStep = m_pUMesh->primitiveTopology == PrimitiveTopology::TriangleStrip ? 3 : 1;
+	const int indexCount = static_cast<int>(m_pUMesh->indices.size());
+	const FrameBuffer::Layout layout = context.layout;
+	using DepthStorage = typename DepthTraits<Format>::Storage;
+	DepthStorage* pDepthBuffer = static_cast<DepthStorage*>(context.pDepthBuffer);
 
-			float wProduct = v0.w * v1.w * v2.w;
+	// Parallelize over triangles
+#pragma omp parallel for
+	for (int inx = 0; inx < indexCount; inx += indexStep)
+	{
+		TriangleSetup triangle;
+		if (!SetupTriangle(context, inx, triangle)) continue;
 
-			auto area = std::abs(Vector2::Cross(edge0_2D, edge1_2D));
+		// Clears whatever part of the bounding box is still pending before the depth test reads it
+		if (context.pFrameBuffer != nullptr) context.pFrameBuffer->Touch(triangle.minX, triangle.minY, triangle.maxX, triangle.maxY);
 
-			// Parallelize over rows of pixels (py)
+		const Vector4& v0 = triangle.v0;
+		const Vector4& v1 = triangle.v1;
+		const Vector4& v2 = triangle.v2;
+		const Vertex_Out& vertex0 = m_pUMesh->vertices_out[triangle.t0];
+		const Vertex_Out& vertex1 = m_pUMesh->vertices_out[triangle.t1];
+		const Vertex_Out& vertex2 = m_pUMesh->vertices_out[triangle.t2];
+
+		// Edge vectors for barycentric coordinates
+		auto e0 = v2 - v1;
+		auto e1 = v0 - v2;
+		auto e2 = v1 - v0;
+
+		Vector2 edge0_2D(e0.x, e0.y);
+		Vector2 edge1_2D(e1.x, e1.y);
+		Vector2 edge2_2D(e2.x, e2.y);
+
+		float wProduct = v0.w * v1.w * v2.w;
+
+		auto area = std::abs(Vector2::Cross(edge0_2D, edge1_2D));
+		const float inverseArea = Reciprocal(area);
+
+		// Screen-space derivatives of the barycentric weights, constant over the triangle
+		const Vector2 weightDdx{ -edge0_2D.y * inverseArea, -edge1_2D.y * inverseArea };
+		const Vector2 weightDdy{ edge0_2D.x * inverseArea, edge1_2D.x * inverseArea };
+		const float weight2Ddx = -edge2_2D.y * inverseArea;
+		const float weight2Ddy = edge2_2D.x * inverseArea;
+
+		// Parallelize over rows of pixels (py)
 #pragma omp parallel for
-			for (int py = minY; py < maxY; ++py) {
-				for (int px = minX; px < maxX; ++px) {
-					ColorRGB finalColor;
-					auto P = Vector2(px + 0.5f, py + 0.5f);
+		for (int py = triangle.minY; py < triangle.maxY; ++py) {
+			auto rowShader = makeRowShader();
+			for (int px = triangle.minX; px < triangle.maxX; ++px) {
+				auto P = Vector2(px + 0.5f, py + 0.5f);
 
-					auto p0 = P - Vector2(v1.x, v1.y);
-					auto p1 = P - Vector2(v2.x, v2.y);
-					auto p2 = P - Vector2(v0.x, v0.y);
+				auto p0 = P - Vector2(v1.x, v1.y);
+				auto p1 = P - Vector2(v2.x, v2.y);
+				auto p2 = P - Vector2(v0.x, v0.y);
 
-					auto weightP0 = Vector2::Cross(edge0_2D, p0) / area;
-					auto weightP1 = Vector2::Cross(edge1_2D, p1) / area;
-					auto weightP2 = Vector2::Cross(edge2_2D, p2) / area;
+				auto weightP0 = Vector2::Cross(edge0_2D, p0) * inverseArea;
+				auto weightP1 = Vector2::Cross(edge1_2D, p1) * inverseArea;
+				auto weightP2 = Vector2::Cross(edge2_2D, p2) * inverseArea;
 
-					auto total= weightP0 + weightP1 + weightP2;
-					if (!(abs(total - 1) <= eps) && !(abs(total + 1) <= eps)) continue;
+				auto total = weightP0 + weightP1 + weightP2;
+				if (!(abs(total - 1) <= eps) && !(abs(total + 1) <= eps)) continue;
 
-					if (cullingMode == CullingMode::Back)
-					{
-						if (!(weightP0 >= 0.f && weightP1 >= 0.f && weightP2 >= 0.f)) continue;
-					}
-					else if (cullingMode == CullingMode::Front)
-					{
-						if (!(weightP0 < 0.f && weightP1 < 0.f && weightP2 < 0.f))
-						{
-							continue;
-						}
-					}
-					else if (cullingMode == CullingMode::No)
-					{
-						if (!((weightP0 < 0.f && weightP1 < 0.f && weightP2 < 0.f) || (weightP0 >= 0.f && weightP1 >= 0.f && weightP2 >= 0.f))) continue;
-					}
-				   
-					float interpolationScale0 = abs(weightP0);
-					float interpolationScale1 = abs(weightP1);
-					float interpolationScale2 = abs(weightP2);
+				if constexpr (Cull == CullingMode::Back)
+				{
+					if (!(weightP0 >= 0.f && weightP1 >= 0.f && weightP2 >= 0.f)) continue;
+				}
+				else if constexpr (Cull == CullingMode::Front)
+				{
+					if (!(weightP0 < 0.f && weightP1 < 0.f && weightP2 < 0.f)) continue;
+				}
+				else
+				{
+					if (!((weightP0 < 0.f && weightP1 < 0.f && weightP2 < 0.f) || (weightP0 >= 0.f && weightP1 >= 0.f && weightP2 >= 0.f))) continue;
+				}
 
-					// Compute z-buffer value for depth testing
-					float zBufferValue = 1.f / (1.f / v0.z * interpolationScale0 +
-						1.f / v1.z * interpolationScale1 +
-						1.f / v2.z * interpolationScale2);
+				float interpolationScale0 = abs(weightP0);
+				float interpolationScale1 = abs(weightP1);
+				float interpolationScale2 = abs(weightP2);
 
-					if (zBufferValue < 0 || zBufferValue > 1) continue;
+				// Compute z-buffer value for depth testing
+				float zBufferValue = 1.f / (1.f / v0.z * interpolationScale0 +
+					1.f / v1.z * interpolationScale1 +
+					1.f / v2.z * interpolationScale2);
 
-					int pixelIndex = px + (py * width);
+				if (zBufferValue < 0 || zBufferValue > 1) continue;
 
-					if (zBufferValue >= pDepthBufferPixels[pixelIndex]) continue;
-					
-					if (!m_ToApplyTransparency)
+				const int pixelIndex = layout.GetIndex(px, py);
+
+				// Interpolated depth for final color calculation
+				auto interpolateDepth = [&]()
 					{
-						pDepthBufferPixels[pixelIndex] = zBufferValue;
-					}
-					
-
-					// Interpolated depth for final color calculation
-					float interpolatedDepth = wProduct / (v1.w * v2.w * interpolationScale0 +
-						v0.w * v2.w * interpolationScale1 +
-						v0.w * v1.w * interpolationScale2);
+						return wProduct / (v1.w * v2.w * interpolationScale0 +
+							v0.w * v2.w * interpolationScale1 +
+							v0.w * v1.w * interpolationScale2);
+					};
+
+				// Only the reversed format needs the view depth before the test
+				float interpolatedDepth{};
+				float reversedDepth{};
+				if constexpr (Format == DepthFormat::ReversedFloat32)
+				{
+					interpolatedDepth = interpolateDepth();
 					if (interpolatedDepth <= 0) continue;
+					reversedDepth = GetReversedDepth(interpolatedDepth, context.nearPlane, context.farPlane);
+				}
 
-					// Texture sampling
-					Vertex_Out pixelVertex;
+				const DepthStorage depthValue = DepthTraits<Format>::Encode(zBufferValue, reversedDepth);
+				if (!DepthTraits<Format>::Passes(depthValue, pDepthBuffer[pixelIndex])) continue;
+
+				if constexpr (DepthWrite)
+				{
+					pDepthBuffer[pixelIndex] = depthValue;
+				}
 
-					pixelVertex.position = (m_pUMesh->vertices[t0].position.ToPoint4() + m_pUMesh->vertices[t1].position.ToPoint4() + m_pUMesh->vertices[t2].position.ToPoint4()) / 3.f;
-					pixelVertex.position.z = zBufferValue;
-					pixelVertex.position.w = interpolatedDepth;
+				if constexpr (Format != DepthFormat::ReversedFloat32)
+				{
+					interpolatedDepth = interpolateDepth();
+					if (interpolatedDepth <= 0) continue;
+				}
 
+				Vertex_Out pixelVertex;
+				pixelVertex.position.z = zBufferValue;
+				pixelVertex.position.w = interpolatedDepth;
 
-					pixelVertex.uv = Vector2::Interpolate(m_pUMesh->vertices_out[t0].uv, m_pUMesh->vertices_out[t1].uv, m_pUMesh->vertices_out[t2].uv,
+				Vector2 uvDdx{};
+				Vector2 uvDdy{};
+				if constexpr (Interpolated != Varyings::None)
+				{
+					pixelVertex.uv = Vector2::Interpolate(vertex0.uv, vertex1.uv, vertex2.uv,
 						v0.w, v1.w, v2.w, interpolationScale0, interpolationScale1, interpolationScale2, interpolatedDepth, wProduct);
+				}
 
-					pixelVertex.normal = Vector3::Interpolate(m_pUMesh->vertices_out[t0].normal, m_pUMesh->vertices_out[t1].normal, m_pUMesh->vertices_out[t2].normal,
+				if constexpr (Interpolated == Varyings::PixelLighting || Interpolated == Varyings::VertexLighting)
+				{
+
+					// Perspective-correct uv derivatives: d(sum(b*uv/w) / sum(b/w)) = sum(db * (uv_i - uv) / w_i) / sum(b/w)
+					const float inverseWeightSum = 1.f / (weightP0 / v0.w + weightP1 / v1.w + weightP2 / v2.w);
+					const Vector2 uvOffset0 = (vertex0.uv - pixelVertex.uv) / v0.w;
+					const Vector2 uvOffset1 = (vertex1.uv - pixelVertex.uv) / v1.w;
+					const Vector2 uvOffset2 = (vertex2.uv - pixelVertex.uv) / v2.w;
+					uvDdx = (uvOffset0 * weightDdx.x + uvOffset1 * weightDdx.y + uvOffset2 * weight2Ddx) * inverseWeightSum;
+					uvDdy = (uvOffset0 * weightDdy.x + uvOffset1 * weightDdy.y + uvOffset2 * weight2Ddy) * inverseWeightSum;
+				}
+
+				if constexpr (Interpolated == Varyings::PixelLighting)
+				{
+					pixelVertex.normal = Vector3::Interpolate(vertex0.normal, vertex1.normal, vertex2.normal,
 						v0.w, v1.w, v2.w, interpolationScale0, interpolationScale1, interpolationScale2, interpolatedDepth, wProduct);
 					pixelVertex.normal.Normalize();
 
+					pixelVertex.viewDirection = Vector3::Interpolate(vertex0.viewDirection, vertex1.viewDirection, vertex2.viewDirection,
+						v0.w, v1.w, v2.w, interpolationScale0, interpolationScale1, interpolationScale2, interpolatedDepth, wProduct);
+					pixelVertex.viewDirection.Normalize();
 
-					pixelVertex.tangent = Vector3::Interpolate(m_pUMesh->vertices_out[t0].tangent, m_pUMesh->vertices_out[t1].tangent, m_pUMesh->vertices_out[t2].tangent,
+					pixelVertex.objectPosition = Vector3::Interpolate(vertex0.objectPosition, vertex1.objectPosition, vertex2.objectPosition,
+						v0.w, v1.w, v2.w, interpolationScale0, interpolationScale1, interpolationScale2, interpolatedDepth, wProduct);
+				}
+				else if constexpr (Interpolated == Varyings::VertexLighting)
+				{
+					pixelVertex.diffuseLight = ColorRGB::Interpolate(vertex0.diffuseLight, vertex1.diffuseLight, vertex2.diffuseLight,
 						v0.w, v1.w, v2.w, interpolationScale0, interpolationScale1, interpolationScale2, interpolatedDepth, wProduct);
-					pixelVertex.tangent.Normalize();
 
-					pixelVertex.viewDirection = Vector3::Interpolate(m_pUMesh->vertices_out[t0].viewDirection, m_pUMesh->vertices_out[t1].viewDirection, m_pUMesh->vertices_out[t2].viewDirection,
+					pixelVertex.specularLight = ColorRGB::Interpolate(vertex0.specularLight, vertex1.specularLight, vertex2.specularLight,
 						v0.w, v1.w, v2.w, interpolationScale0, interpolationScale1, interpolationScale2, interpolatedDepth, wProduct);
-					pixelVertex.viewDirection.Normalize();
+				}
 
-					// If texture mapping is enabled, sample the texture
-					if (displayMode == DisplayMode::DepthBuffer)
-					{
-						auto clampedValue = std::clamp(Remap(zBufferValue, 0.995f, 1.f, 0.f, 1.f), 0.f, 1.f);
-						finalColor = ColorRGB(clampedValue, clampedValue, clampedValue);
-					}
-					if (displayMode == DisplayMode::ShadingMode)
+				rowShader.Shade(pixelIndex, pixelVertex, uvDdx, uvDdy);
+			}
+			rowShader.Flush();
+		}
+	}
+}
+
+template<ShadingMode Mode, bool NormalMap, bool Blend, CullingMode Cull, bool UseMaterial>
+void Mesh3D::RenderShaded(const DrawContext& context) const
+{
+	// The transparency buffer resolves blended layers in any order, they only test the opaque depth
+	constexpr bool depthWrite = !Blend;
+
+	// The cache already holds the lighting, a pixel is one bilinear fetch. Texels the cache has not shaded yet
+	// are shaded on the spot, only along disocclusions for the one frame before the cache catches up
+	if constexpr (Mode == ShadingMode::Decoupled)
+	{
+		const auto shadeTexel = [&](const ShadingCache::Surface& surface) { return ShadeCacheTexel(context, surface, NormalMap); };
+		Rasterize<Cull, depthWrite, Varyings::Uv>(context, [&]()
+			{
+				return ColorRowShader{ &context.backBufferFormat, context.pBackBufferPixels, [&](int, Vertex_Out& pixelVertex, const Vector2&, const Vector2&)
 					{
-						if (m_ToApplyTransparency)
-						{
-							ColorRGB existingPixelColor;
-							uint32_t existingPixel = pBackBufferPixels[pixelIndex];
-							uint8_t existingR, existingG, existingB;
-							SDL_GetRGB(existingPixel, pBackBuffer->format, &existingR, &existingG, &existingB);
-							existingPixelColor = { existingR / 255.0f, existingG / 255.0f, existingB / 255.0f };
+						return context.pShadingCache->Sample(pixelVertex.uv, shadeTexel);
+					} };
+			});
+		return;
+	}
 
-							//existingPixelColor.MaxToOne();
+#if defined(__AVX2__)
+	// Opaque material draws are the bulk of the work, they shade 8 pixels at a time
+	if constexpr (UseMaterial && !Blend && Mode != ShadingMode::Gouraud)
+	{
+		Rasterize<Cull, depthWrite, Varyings::PixelLighting>(context, [&]() { return BatchRowShader<Mode, NormalMap>{ &context }; });
+		return;
+	}
+#endif
 
-							existingPixelColor.r = std::clamp(existingPixelColor.r, 0.f, 1.f);
-							existingPixelColor.g = std::clamp(existingPixelColor.g, 0.f, 1.f);
-							existingPixelColor.b = std::clamp(existingPixelColor.b, 0.f, 1.f);
+	constexpr Varyings interpolated = Mode == ShadingMode::Gouraud ? Varyings::VertexLighting : Varyings::PixelLighting;
 
-							finalColor = PixelShading(pixelVertex, shadingMode, isNormalMap, existingPixelColor);
-						}
-						else
+	// Blended fragments never touch the back buffer here, the transparency buffer composites them after the draw
+	if constexpr (Blend)
+	{
+		Rasterize<Cull, depthWrite, interpolated>(context, [&]()
+			{
+				return PixelRowShader{ [&](int pixelIndex, Vertex_Out& pixelVertex, const Vector2& uvDdx, const Vector2& uvDdy)
+					{
+						// A footprint that only reaches alpha 0 texels would accumulate nothing, it skips sampling and shading
+						if constexpr (!UseMaterial && Mode != ShadingMode::Specular)
 						{
-							finalColor = PixelShading(pixelVertex, shadingMode, isNormalMap);
+							if (context.pDiffuseTexture != nullptr && context.pDiffuseTexture->IsTransparent(pixelVertex.uv, uvDdx, uvDdy, context.filteringTechnique)) return;
 						}
-					}
-					finalColor.r = std::clamp(finalColor.r, 0.f, 1.f); //Clamp because MaxToOne version has some artifacts
-					finalColor.g = std::clamp(finalColor.g, 0.f, 1.f);
-					finalColor.b = std::clamp(finalColor.b, 0.f, 1.f);
-
-					pBackBufferPixels[pixelIndex] = SDL_MapRGB(pBackBuffer->format,
-						static_cast<uint8_t>(finalColor.r * 255.f),
-						static_cast<uint8_t>(finalColor.g * 255.f),
-						static_cast<uint8_t>(finalColor.b * 255.f));
-				}
+
+						float alpha{ 1.f };
+						const ColorRGB color = ShadePixel<Mode, NormalMap, Blend, UseMaterial>(context, pixelIndex, pixelVertex, uvDdx, uvDdy, alpha);
+						context.pTransparencyBuffer->Accumulate(pixelIndex, color, alpha, pixelVertex.position.w);
+					} };
+			});
+	}
+	else
+	{
+		Rasterize<Cull, depthWrite, interpolated>(context, [&]()
+			{
+				return ColorRowShader{ &context.backBufferFormat, context.pBackBufferPixels, [&](int pixelIndex, Vertex_Out& pixelVertex, const Vector2& uvDdx, const Vector2& uvDdy)
+					{
+						float alpha{ 1.f };
+						return ShadePixel<Mode, NormalMap, Blend, UseMaterial>(context, pixelIndex, pixelVertex, uvDdx, uvDdy, alpha);
+					} };
+			});
+	}
+}
+
+template<CullingMode Cull, bool DepthWrite>
+void Mesh3D::RenderDepth(const DrawContext& context) const
+{
+	DispatchDepthFormat(context.depthFormat, [&](auto format)
+		{
+			constexpr DepthFormat depthFormat = decltype(format)::value;
+			RasterizeWithDepth<depthFormat, Cull, DepthWrite, Varyings::None>(context, [&]()
+				{
+					return ColorRowShader{ &context.backBufferFormat, context.pBackBufferPixels, [&](int, Vertex_Out& pixelVertex, const Vector2&, const Vector2&)
+						{
+							// The depth as stored, so the format's precision shows as banding
+							const float reversedDepth = GetReversedDepth(pixelVertex.position.w, context.nearPlane, context.farPlane);
+							const float depth = DepthTraits<depthFormat>::Decode(DepthTraits<depthFormat>::Encode(pixelVertex.position.z, reversedDepth));
+							const float clampedValue = std::clamp(Remap(depth, 0.995f, 1.f, 0.f, 1.f), 0.f, 1.f);
+							return ColorRGB(clampedValue, clampedValue, clampedValue);
+						} };
+				});
+		});
+}
+
+template<CullingMode Cull>
+void Mesh3D::RenderDepthPrepass(const DrawContext& context) const
+{
+	Rasterize<Cull, true, Varyings::None>(context, []() { return NullRowShader{}; });
+}
+
+#if defined(__AVX2__)
+namespace
+{
+	struct Vector3x8
+	{
+		__m256 x;
+		__m256 y;
+		__m256 z;
+	};
+
+	inline Vector3x8 Load(const float* pX, const float* pY, const float* pZ)
+	{
+		return { _mm256_load_ps(pX), _mm256_load_ps(pY), _mm256_load_ps(pZ) };
+	}
+
+	inline __m256 Dot(const Vector3x8& a, const Vector3x8& b)
+	{
+		return _mm256_fmadd_ps(a.x, b.x, _mm256_fmadd_ps(a.y, b.y, _mm256_mul_ps(a.z, b.z)));
+	}
+
+	inline Vector3x8 Cross(const Vector3x8& a, const Vector3x8& b)
+	{
+		return {
+			_mm256_fmsub_ps(a.y, b.z, _mm256_mul_ps(a.z, b.y)),
+			_mm256_fmsub_ps(a.z, b.x, _mm256_mul_ps(a.x, b.z)),
+			_mm256_fmsub_ps(a.x, b.y, _mm256_mul_ps(a.y, b.x)) };
+	}
+
+	// Same contract as dae::InverseSqrt, estimate plus one Newton step under DAE_FAST_MATH
+	inline __m256 InverseSqrt8(__m256 value)
+	{
+#if defined(DAE_FAST_MATH)
+		const __m256 estimate = _mm256_rsqrt_ps(value);
+		const __m256 halfValue = _mm256_mul_ps(value, _mm256_set1_ps(.5f));
+		return _mm256_mul_ps(estimate, _mm256_fnmadd_ps(halfValue, _mm256_mul_ps(estimate, estimate), _mm256_set1_ps(1.5f)));
+#else
+		return _mm256_div_ps(_mm256_set1_ps(1.f), _mm256_sqrt_ps(value));
+#endif
+	}
+
+	inline Vector3x8 Normalized(const Vector3x8& v)
+	{
+		const __m256 inverseLength = InverseSqrt8(Dot(v, v));
+		return { _mm256_mul_ps(v.x, inverseLength), _mm256_mul_ps(v.y, inverseLength), _mm256_mul_ps(v.z, inverseLength) };
+	}
+
+}
+
+template<ShadingMode Mode, bool NormalMap>
+void Mesh3D::BatchRowShader<Mode, NormalMap>::Shade(int pixelIndex, Vertex_Out& pixelVertex, const Vector2& uvDdx, const Vector2& uvDdy)
+{
+	// Every lane of a batch shades with the same tile's lights
+	const int tileIndex = GetLightTileIndex(*pContext, pixelIndex);
+	if (batch.count > 0 && tileIndex != batch.tileIndex) Flush();
+	batch.tileIndex = tileIndex;
+
+	const int lane = batch.count;
+	batch.pixelIndex[lane] = pixelIndex;
+	batch.normalX[lane] = pixelVertex.normal.x;
+	batch.normalY[lane] = pixelVertex.normal.y;
+	batch.normalZ[lane] = pixelVertex.normal.z;
+	batch.viewX[lane] = pixelVertex.viewDirection.x;
+	batch.viewY[lane] = pixelVertex.viewDirection.y;
+	batch.viewZ[lane] = pixelVertex.viewDirection.z;
+	batch.positionX[lane] = pixelVertex.objectPosition.x;
+	batch.positionY[lane] = pixelVertex.objectPosition.y;
+	batch.positionZ[lane] = pixelVertex.objectPosition.z;
+
+	// Filtered, paged fetches stay per lane, everything after them runs in the vector lanes
+	if constexpr (Mode != ShadingMode::ObservedArea || NormalMap)
+	{
+		const TextureFilter::Footprint footprint = TextureFilter::ComputeFootprint(uvDdx, uvDdy, pContext->pMaterial->GetWidth(), pContext->pMaterial->GetHeight(), pContext->filteringTechnique);
+		const bool useNormalMap = NormalMap && footprint.lod < m_NormalMapMaxLod;
+		const MaterialSample material = pContext->pMaterial->Sample(pixelVertex.uv, footprint, pContext->filteringTechnique, useNormalMap);
+		batch.diffuseR[lane] = material.diffuse.r;
+		batch.diffuseG[lane] = material.diffuse.g;
+		batch.diffuseB[lane] = material.diffuse.b;
+		batch.specularR[lane] = material.specular.r;
+		batch.specularG[lane] = material.specular.g;
+		batch.specularB[lane] = material.specular.b;
+		batch.gloss[lane] = material.gloss;
+
+		// Lanes past the normal map LOD carry the vertex normal, so the batch math stays uniform
+		const Vector3& laneNormal = useNormalMap ? material.normal : pixelVertex.normal;
+		batch.mapNormalX[lane] = laneNormal.x;
+		batch.mapNormalY[lane] = laneNormal.y;
+		batch.mapNormalZ[lane] = laneNormal.z;
+	}
+
+	if (++batch.count == PixelBatch::Lanes) Flush();
+}
+
+template<ShadingMode Mode, bool NormalMap>
+void Mesh3D::BatchRowShader<Mode, NormalMap>::Flush()
+{
+	if (batch.count == 0) return;
+
+	constexpr float shininess = 25.f;
+	constexpr float ambient = .025f;
+
+	const __m256 zero = _mm256_setzero_ps();
+
+	// Baked normals are already in object space, filtering only shortens them
+	Vector3x8 normal = Load(batch.normalX, batch.normalY, batch.normalZ);
+	if constexpr (NormalMap)
+	{
+		normal = Normalized(Load(batch.mapNormalX, batch.mapNormalY, batch.mapNormalZ));
+	}
+
+	const Vector3x8 position = Load(batch.positionX, batch.positionY, batch.positionZ);
+	const Vector3x8 view = Load(batch.viewX, batch.viewY, batch.viewZ);
+	const __m256 exponent = _mm256_mul_ps(_mm256_load_ps(batch.gloss), _mm256_set1_ps(shininess));
+	const Vector3x8 diffuseAlbedo{
+		_mm256_mul_ps(_mm256_load_ps(batch.diffuseR), _mm256_set1_ps(1.f / PI)),
+		_mm256_mul_ps(_mm256_load_ps(batch.diffuseG), _mm256_set1_ps(1.f / PI)),
+		_mm256_mul_ps(_mm256_load_ps(batch.diffuseB), _mm256_set1_ps(1.f / PI)) };
+	const Vector3x8 specularColor = Load(batch.specularR, batch.specularG, batch.specularB);
+
+	// Upper bound of each lane's specular color, lights whose Phong cannot show on any lane skip it
+	const __m256 maxSpecular = _mm256_max_ps(specularColor.x, _mm256_max_ps(specularColor.y, specularColor.z));
+
+	// Accumulated radiance per lane, x/y/z hold r/g/b
+	Vector3x8 result{ zero, zero, zero };
+	__m256 isLit = zero;
+
+	const LightGrid& lightGrid = *pContext->pLightGrid;
+	const LightGrid::LightRange lights = lightGrid.GetLights(batch.tileIndex, false);
+	for (uint32_t i = 0; i < lights.count; ++i)
+	{
+		const Light& light = pContext->pLights[lights.pIndices[i]];
+
+		Vector3x8 toLight;
+		__m256 falloff;
+		if (light.type == LightType::Directional)
+		{
+			toLight = { _mm256_set1_ps(-light.direction.x), _mm256_set1_ps(-light.direction.y), _mm256_set1_ps(-light.direction.z) };
+			falloff = _mm256_set1_ps(1.f);
+		}
+		else
+		{
+			toLight = {
+				_mm256_sub_ps(_mm256_set1_ps(light.position.x), position.x),
+				_mm256_sub_ps(_mm256_set1_ps(light.position.y), position.y),
+				_mm256_sub_ps(_mm256_set1_ps(light.position.z), position.z) };
+			const __m256 distanceSquared = Dot(toLight, toLight);
+			const __m256 inverseDistance = InverseSqrt8(distanceSquared);
+			toLight = { _mm256_mul_ps(toLight.x, inverseDistance), _mm256_mul_ps(toLight.y, inverseDistance), _mm256_mul_ps(toLight.z, inverseDistance) };
+
+			// Same windowed inverse square as LightGrid::GetIncidentLight
+			const __m256 rangeRatio = _mm256_mul_ps(distanceSquared, _mm256_set1_ps(1.f / (light.range * light.range)));
+			__m256 window = _mm256_max_ps(_mm256_fnmadd_ps(rangeRatio, rangeRatio, _mm256_set1_ps(1.f)), zero);
+			window = _mm256_mul_ps(window, window);
+			falloff = _mm256_div_ps(window, _mm256_add_ps(distanceSquared, _mm256_set1_ps(1.f)));
+
+			if (light.type == LightType::Spot)
+			{
+				const Vector3x8 direction{ _mm256_set1_ps(light.direction.x), _mm256_set1_ps(light.direction.y), _mm256_set1_ps(light.direction.z) };
+				const __m256 cosOfCone = _mm256_sub_ps(zero, Dot(toLight, direction));
+				__m256 t = _mm256_mul_ps(_mm256_sub_ps(cosOfCone, _mm256_set1_ps(light.outerConeCos)), _mm256_set1_ps(1.f / (light.innerConeCos - light.outerConeCos)));
+				t = _mm256_min_ps(_mm256_max_ps(t, zero), _mm256_set1_ps(1.f));
+				falloff = _mm256_mul_ps(falloff, _mm256_mul_ps(_mm256_mul_ps(t, t), _mm256_fnmadd_ps(_mm256_set1_ps(2.f), t, _mm256_set1_ps(3.f))));
 			}
 		}
 
+		const __m256 cosOfAngle = Dot(normal, toLight);
+		const __m256 laneLit = _mm256_and_ps(_mm256_cmp_ps(cosOfAngle, zero, _CMP_GE_OQ), _mm256_cmp_ps(falloff, zero, _CMP_GT_OQ));
+		if (_mm256_movemask_ps(laneLit) == 0) continue;
+		isLit = _mm256_or_ps(isLit, laneLit);
+
+		// Light color times falloff, zero on the lanes the light does not reach
+		falloff = _mm256_and_ps(falloff, laneLit);
+		const Vector3x8 radiance{
+			_mm256_mul_ps(falloff, _mm256_set1_ps(light.color.r)),
+			_mm256_mul_ps(falloff, _mm256_set1_ps(light.color.g)),
+			_mm256_mul_ps(falloff, _mm256_set1_ps(light.color.b)) };
+
+		if constexpr (Mode == ShadingMode::ObservedArea)
+		{
+			result.x = _mm256_fmadd_ps(radiance.x, cosOfAngle, result.x);
+			result.y = _mm256_fmadd_ps(radiance.y, cosOfAngle, result.y);
+			result.z = _mm256_fmadd_ps(radiance.z, cosOfAngle, result.z);
+		}
+		if constexpr (Mode == ShadingMode::Diffuse || Mode == ShadingMode::Combined)
+		{
+			const __m256 diffuseScale = _mm256_mul_ps(cosOfAngle, _mm256_set1_ps(light.intensity));
+			result.x = _mm256_fmadd_ps(_mm256_mul_ps(diffuseAlbedo.x, radiance.x), diffuseScale, result.x);
+			result.y = _mm256_fmadd_ps(_mm256_mul_ps(diffuseAlbedo.y, radiance.y), diffuseScale, result.y);
+			result.z = _mm256_fmadd_ps(_mm256_mul_ps(diffuseAlbedo.z, radiance.z), diffuseScale, result.z);
+		}
+		if constexpr (Mode == ShadingMode::Specular || Mode == ShadingMode::Combined)
+		{
+			const __m256 specularBound = _mm256_mul_ps(_mm256_mul_ps(maxSpecular, falloff), _mm256_set1_ps(std::max({ light.color.r, light.color.g, light.color.b })));
+			if (_mm256_movemask_ps(_mm256_cmp_ps(specularBound, _mm256_set1_ps(m_MinSpecularContribution), _CMP_GE_OQ)) == 0) continue;
+
+			const __m256 twoNDotL = _mm256_mul_ps(_mm256_max_ps(cosOfAngle, zero), _mm256_set1_ps(2.f));
+			const Vector3x8 reflect{
+				_mm256_fnmadd_ps(twoNDotL, normal.x, toLight.x),
+				_mm256_fnmadd_ps(twoNDotL, normal.y, toLight.y),
+				_mm256_fnmadd_ps(twoNDotL, normal.z, toLight.z) };
+			const __m256 cosAlpha = _mm256_max_ps(Dot(reflect, view), zero);
+			const __m256 phong = PhongLookupTable::Get().Evaluate8(cosAlpha, exponent);
+
+			result.x = _mm256_fmadd_ps(_mm256_mul_ps(specularColor.x, radiance.x), phong, result.x);
+			result.y = _mm256_fmadd_ps(_mm256_mul_ps(specularColor.y, radiance.y), phong, result.y);
+			result.z = _mm256_fmadd_ps(_mm256_mul_ps(specularColor.z, radiance.z), phong, result.z);
+		}
 	}
+
+	if constexpr (Mode == ShadingMode::Combined)
+	{
+		const __m256 ambientTerm = _mm256_set1_ps(ambient);
+		result = { _mm256_add_ps(result.x, ambientTerm), _mm256_add_ps(result.y, ambientTerm), _mm256_add_ps(result.z, ambientTerm) };
+	}
+
+	// Surfaces no light reaches are black, ambient included
+	const __m256 red = _mm256_and_ps(result.x, isLit);
+	const __m256 green = _mm256_and_ps(result.y, isLit);
+	const __m256 blue = _mm256_and_ps(result.z, isLit);
+
+	const DrawContext& context = *pContext;
+	const PixelFormat& format = context.backBufferFormat;
+	alignas(32) uint32_t pixels[PixelBatch::Lanes];
+	if (format.isPacked)
+	{
+		_mm256_store_si256(reinterpret_cast<__m256i*>(pixels), format.Pack8(red, green, blue));
+	}
+	else
+	{
+		alignas(32) float r[PixelBatch::Lanes], g[PixelBatch::Lanes], b[PixelBatch::Lanes];
+		_mm256_store_ps(r, red);
+		_mm256_store_ps(g, green);
+		_mm256_store_ps(b, blue);
+		for (int lane = 0; lane < batch.count; ++lane)
+		{
+			pixels[lane] = format.Pack(ColorRGB{ r[lane], g[lane], b[lane] });
+		}
+	}
+
+	for (int lane = 0; lane < batch.count; ++lane)
+	{
+		context.pBackBufferPixels[batch.pixelIndex[lane]] = pixels[lane];
+	}
+	batch.count = 0;
 }
+#endif
 
 void Mesh3D::SetCullingMode(CullingMode cullingMode, ID3D11DeviceContext* context)
 {	
@@ -342,132 +961,297 @@ void Mesh3D::SetCullingMode(CullingMode cullingMode, ID3D11DeviceContext* contex
 	}
 }
 
+void Mesh3D::EnableShadingCache(int size, int refreshPeriod)
+{
+	m_pUShadingCache = std::make_unique<ShadingCache>(size, size, refreshPeriod, m_pUMesh->vertices, m_pUMesh->indices);
+}
+
 void Mesh3D::VertexTransformationFunction(const Camera& camera, const Matrix& rotationMatrix)
+{
+	TransformVertices(camera, rotationMatrix, m_VertexStage, int(std::max(std::thread::hardware_concurrency(), 1u)));
+	SwapVertexStage(m_VertexStage);
+}
+
+void Mesh3D::TransformVertices(const Camera& camera, const Matrix& rotationMatrix, VertexStage& stage, int threadCount) const
 {
 	// Precompute transformation matrix
 	auto rotatedWorldMatrix = rotationMatrix * m_pUMesh->worldMatrix;
 	auto overallMatrix = rotatedWorldMatrix * camera.viewMatrix * camera.projectionMatrix;
 
-	// Resize vertices_out to match input vertices
-	m_pUMesh->vertices_out.resize(m_pUMesh->vertices.size());
-
-	// Transform vertices in parallel
-#pragma omp parallel for
-	for (size_t i = 0; i < m_pUMesh->vertices.size(); ++i) {
-		m_pUMesh->vertices_out[i].normal = rotatedWorldMatrix.TransformVector(m_pUMesh->vertices[i].normal).Normalized();
+	// Varyings stay in object space, only the camera is moved into it
+	stage.objectToWorld = rotatedWorldMatrix;
+	stage.objectCameraPosition = Matrix::Inverse(rotatedWorldMatrix).TransformPoint(camera.origin);
+	const Vector3 objectCameraPosition = stage.objectCameraPosition;
 
-		m_pUMesh->vertices_out[i].tangent = rotatedWorldMatrix.TransformVector(m_pUMesh->vertices[i].tangent).Normalized();
+	// Resize the output to match input vertices
+	const std::vector<Vertex>& vertices = m_pUMesh->vertices;
+	std::vector<Vertex_Out>& verticesOut = stage.vertices;
+	verticesOut.resize(vertices.size());
 
+	// Transform vertices in parallel
+#pragma omp parallel for num_threads(threadCount)
+	for (int i = 0; i < int(vertices.size()); ++i) {
+		verticesOut[i].normal = vertices[i].normal.Normalized();
 
-		auto rotatedWorldPosition = rotatedWorldMatrix.TransformPoint(m_pUMesh->vertices[i].position);
-		m_pUMesh->vertices_out[i].viewDirection = rotatedWorldPosition - camera.origin;
-		m_pUMesh->vertices_out[i].viewDirection.Normalize();
+		verticesOut[i].objectPosition = vertices[i].position;
+		verticesOut[i].viewDirection = vertices[i].position - objectCameraPosition;
+		verticesOut[i].viewDirection.Normalize();
 
-		Vector4 viewSpacePosition = overallMatrix.TransformPoint(m_pUMesh->vertices[i].position.ToVector4());
+		Vector4 viewSpacePosition = overallMatrix.TransformPoint(vertices[i].position.ToVector4());
 		Vector4 projectionSpacePosition = viewSpacePosition / viewSpacePosition.w;
 
-		m_pUMesh->vertices_out[i].position = projectionSpacePosition;
-		m_pUMesh->vertices_out[i].uv = m_pUMesh->vertices[i].uv;
+		verticesOut[i].position = projectionSpacePosition;
+		verticesOut[i].uv = vertices[i].uv;
 	}
 }
 
-ColorRGB Mesh3D::PixelShading(Vertex_Out& v, ShadingMode shadingMode, bool isNormalMap, ColorRGB existingPixelColor) const
+void Mesh3D::SwapVertexStage(VertexStage& stage)
 {
-	ColorRGB finalColor;
+	m_pUMesh->vertices_out.swap(stage.vertices);
+	m_ObjectToWorld = stage.objectToWorld;
+	m_ObjectCameraPosition = stage.objectCameraPosition;
+}
 
-	Vector3 lightDirection = { .577f, -.577f,  .577f };
-	constexpr float lightIntensity = 7.f;
+void Mesh3D::LightVertices(const DrawContext& context) const
+{
 	constexpr float shininess = 25.f;
-	constexpr ColorRGB ambient = { .025f,.025f,.025f };
 
-	
-	if (isNormalMap)
+	// No tile exists for a vertex, every light is tested and its range does the culling
+	const uint32_t lightCount = context.pLightGrid->GetLightCount();
+	std::vector<Vertex_Out>& vertices = m_pUMesh->vertices_out;
+
+#pragma omp parallel for
+	for (int i = 0; i < int(vertices.size()); ++i)
 	{
-		Vector3 binormal = Vector3::Cross(v.normal, v.tangent);
-		//Matrix tangentSpaceAxis = Matrix{ v.tangent, binormal, v.normal, Vector3::Zero };
-		ColorRGB normalMapSample = m_pEffect->GetNormalTexture()->Sample(v.uv);
-		v.normal = (v.tangent * (2.f * normalMapSample.r - 1.f) + binormal * (2.f * normalMapSample.g - 1.f) + v.normal * (2.f * normalMapSample.b - 1.f)).Normalized();
-	}  
+		Vertex_Out& vertex = vertices[i];
+
+		float gloss{};
+		if (context.pMaterial != nullptr)
+		{
+			gloss = context.pMaterial->Sample(vertex.uv, TextureFilter::Footprint{ m_VertexMaterialLod }, FilteringTechnique::Point, false).gloss;
+		}
+		else if (context.pGlossinessTexture != nullptr)
+		{
+			gloss = context.pGlossinessTexture->Sample(vertex.uv).r;
+		}
 
-	float cosOfAngle{ Vector3::Dot(v.normal, -lightDirection) };
+		// White specular, the pixel stage multiplies the material's color in
+		ColorRGB diffuseLight{};
+		ColorRGB specularLight{};
+		for (uint32_t lightIndex = 0; lightIndex < lightCount; ++lightIndex)
+		{
+			const Light& light = context.pLights[lightIndex];
 
-	if (cosOfAngle < 0.f && !m_ToApplyTransparency) return ColorRGB(0.f, 0.f, 0.f);
+			Vector3 toLight;
+			ColorRGB radiance;
+			if (!LightGrid::GetIncidentLight(light, vertex.objectPosition, toLight, radiance)) continue;
 
-	ColorRGB observedArea = { cosOfAngle, cosOfAngle, cosOfAngle };
+			const float cosOfAngle{ Vector3::Dot(vertex.normal, toLight) };
+			if (cosOfAngle < 0.f) continue;
 
-	const Texture* diffuseTexturePtr = m_pEffect->GetDiffuseTexture();
-	ColorRGB diffuse;
-	if (diffuseTexturePtr != nullptr)
-	{
-		if (!m_ToApplyTransparency)
-		{
-			diffuse = Lambert(diffuseTexturePtr->Sample(v.uv));
+			diffuseLight += radiance * (cosOfAngle * light.intensity);
+			specularLight += Phong(ColorRGB{ 1.f, 1.f, 1.f }, gloss * shininess, toLight, vertex.viewDirection, vertex.normal) * radiance;
 		}
-		else
+
+		vertex.diffuseLight = diffuseLight;
+		vertex.specularLight = specularLight;
+	}
+}
+
+void Mesh3D::UpdateShadingCache(const DrawContext& context, bool normalMap) const
+{
+	m_pUShadingCache->Update(context.pLights, context.pLightGrid->GetLightCount(), [&](const ShadingCache::Surface& surface)
 		{
-			ColorRGBA sampleWithAlpha = diffuseTexturePtr->SampleWithAlpha(v.uv);
-			ColorRGB currentColor = ColorRGBA::GetColorRGB(sampleWithAlpha);
-			float alphaValue = sampleWithAlpha.a;
-			diffuse = (currentColor * alphaValue) + (existingPixelColor * (1.0f - alphaValue));
-		}
+			return ShadeCacheTexel(context, surface, normalMap);
+		});
+}
+
+ColorRGB Mesh3D::ShadeCacheTexel(const DrawContext& context, const ShadingCache::Surface& surface, bool normalMap) const
+{
+	constexpr float shininess = 25.f;
+	constexpr ColorRGB ambient = { .025f,.025f,.025f };
+
+	// One cache texel covers this many material texels, the material is read at the matching mip
+	const MaterialTexture& material = *context.pMaterial;
+	const ShadingCache& cache = *m_pUShadingCache;
+	const TextureFilter::Footprint footprint{ std::log2(std::max(float(material.GetWidth()) / cache.GetWidth(), 1.f)) };
+	const uint32_t lightCount = context.pLightGrid->GetLightCount();
+
+	const MaterialSample sample = material.Sample(surface.uv, footprint, context.filteringTechnique, normalMap);
+	const Vector3 normal = normalMap ? sample.normal.Normalized() : surface.normal;
+	const Vector3 viewDirection = (surface.position - m_ObjectCameraPosition).Normalized();
+	const ColorRGB diffuseAlbedo = Lambert(sample.diffuse);
+	const float maxSpecular = std::max({ sample.specular.r, sample.specular.g, sample.specular.b });
+
+	// A texel has no screen tile, every light is tested and its range does the culling
+	ColorRGB diffuse{};
+	ColorRGB specular{};
+	bool isLit{ false };
+	for (uint32_t i = 0; i < lightCount; ++i)
+	{
+		const Light& light = context.pLights[i];
+
+		Vector3 toLight;
+		ColorRGB radiance;
+		if (!LightGrid::GetIncidentLight(light, surface.position, toLight, radiance)) continue;
+
+		const float cosOfAngle{ Vector3::Dot(normal, toLight) };
+		if (cosOfAngle < 0.f) continue;
+		isLit = true;
+
+		diffuse += diffuseAlbedo * radiance * (cosOfAngle * light.intensity);
+		if (maxSpecular * std::max({ radiance.r, radiance.g, radiance.b }) < m_MinSpecularContribution) continue;
+		specular += Phong(sample.specular, sample.gloss * shininess, toLight, viewDirection, normal) * radiance;
 	}
-	else
+
+	if (!isLit) return ColorRGB(0.f, 0.f, 0.f);
+	return ambient + specular + diffuse;
+}
+
+int Mesh3D::GetLightTileIndex(const DrawContext& context, int pixelIndex)
+{
+	int x{};
+	int y{};
+	context.layout.GetPixel(pixelIndex, x, y);
+	return context.pLightGrid->GetTileIndex(x * context.lightGridScale, y * context.lightGridScale);
+}
+
+template<ShadingMode Mode, bool NormalMap, bool Blend, bool UseMaterial>
+ColorRGB Mesh3D::ShadePixel(const DrawContext& context, int pixelIndex, Vertex_Out& v, const Vector2& uvDdx, const Vector2& uvDdy, float& alpha) const
+{
+	constexpr float shininess = 25.f;
+	constexpr ColorRGB ambient = { .025f,.025f,.025f };
+
+	MaterialSample material;
+	if constexpr (UseMaterial)
 	{
-		diffuse = colors::Black;
+		// Single fetch for diffuse, normal, specular and gloss, the normal only while its detail is visible
+		const TextureFilter::Footprint footprint = TextureFilter::ComputeFootprint(uvDdx, uvDdy, context.pMaterial->GetWidth(), context.pMaterial->GetHeight(), context.filteringTechnique);
+		const bool useNormalMap = NormalMap && footprint.lod < m_NormalMapMaxLod;
+		material = context.pMaterial->Sample(v.uv, footprint, context.filteringTechnique, useNormalMap);
+
+		// Baked object-space normals replace the interpolated one, filtering only shortens them
+		if (useNormalMap) v.normal = material.normal.Normalized();
 	}
 
-	const Texture* glossTexturePtr = m_pEffect->GetGlossinessTexture();
-	ColorRGB gloss;
-	if (glossTexturePtr != nullptr)
+	// Surface terms first, the light loop below only scales them
+	ColorRGB diffuseAlbedo{};
+	ColorRGB specularColor{};
+	float gloss{};
+	if constexpr (UseMaterial)
 	{
-		gloss = glossTexturePtr->Sample(v.uv);
+		diffuseAlbedo = Lambert(material.diffuse);
+		specularColor = material.specular;
+		gloss = material.gloss;
 	}
 	else
 	{
-		gloss = colors::Black;
+		// Missing maps read as black, the pointer checks are uniform over the draw
+		if constexpr (Mode != ShadingMode::Specular)
+		{
+			if (context.pDiffuseTexture != nullptr)
+			{
+				const ColorRGBA sampleWithAlpha = context.pDiffuseTexture->Sample(v.uv, uvDdx, uvDdy, context.filteringTechnique);
+				if constexpr (Blend)
+				{
+					diffuseAlbedo = ColorRGBA::GetColorRGB(sampleWithAlpha);
+					alpha = sampleWithAlpha.a;
+				}
+				else
+				{
+					diffuseAlbedo = Lambert(ColorRGBA::GetColorRGB(sampleWithAlpha));
+				}
+			}
+		}
+
+		// A blended Combined pixel is only its diffuse, so gloss and specular are skipped there
+		if constexpr (Mode == ShadingMode::Specular || (Mode == ShadingMode::Combined && !Blend))
+		{
+			if (context.pGlossinessTexture != nullptr)
+			{
+				gloss = context.pGlossinessTexture->Sample(v.uv, uvDdx, uvDdy, context.filteringTechnique).r;
+			}
+		}
+
+		// Gouraud took the gloss per vertex
+		if constexpr (Mode == ShadingMode::Specular || ((Mode == ShadingMode::Combined || Mode == ShadingMode::Gouraud) && !Blend))
+		{
+			if (context.pSpecularTexture != nullptr)
+			{
+				specularColor = ColorRGBA::GetColorRGB(context.pSpecularTexture->Sample(v.uv, uvDdx, uvDdy, context.filteringTechnique));
+			}
+		}
 	}
-	
-	float exp = gloss.r * shininess;
 
-	const Texture* specularTexturePtr = m_pEffect->GetSpecularTexture();
-	ColorRGB specular;
-	if (specularTexturePtr != nullptr)
+	if constexpr ((Mode == ShadingMode::Combined || Mode == ShadingMode::Gouraud) && Blend && !UseMaterial)
 	{
-		specular = Phong(specularTexturePtr->Sample(v.uv), exp, -lightDirection, v.viewDirection, v.normal);
+		return diffuseAlbedo;
 	}
-	else
+
+	if constexpr (Mode == ShadingMode::Gouraud)
 	{
-		specular = colors::Black;
+		// Lit per vertex, unlit where no light reached any of the triangle's vertices
+		if (v.diffuseLight.r + v.diffuseLight.g + v.diffuseLight.b + v.specularLight.r + v.specularLight.g + v.specularLight.b <= 0.f) return ColorRGB(0.f, 0.f, 0.f);
+		return ambient + specularColor * v.specularLight + diffuseAlbedo * v.diffuseLight;
 	}
 
-	switch (shadingMode)
+	const float maxSpecular = std::max({ specularColor.r, specularColor.g, specularColor.b });
+
+	// Only the lights culled into this pixel's tile
+	ColorRGB observedArea{};
+	ColorRGB diffuse{};
+	ColorRGB specular{};
+	bool isLit{ false };
+
+	const LightGrid& lightGrid = *context.pLightGrid;
+	const LightGrid::LightRange lights = lightGrid.GetLights(GetLightTileIndex(context, pixelIndex), Blend);
+	for (uint32_t i = 0; i < lights.count; ++i)
 	{
-	case ShadingMode::ObservedArea:
-		finalColor += observedArea;
-		break;
+		const Light& light = context.pLights[lights.pIndices[i]];
 
-	case ShadingMode::Diffuse:
-		finalColor += diffuse * observedArea * lightIntensity;
-		break;
+		Vector3 toLight;
+		ColorRGB radiance;
+		if (!LightGrid::GetIncidentLight(light, v.objectPosition, toLight, radiance)) continue;
 
-	case ShadingMode::Specular:
-		finalColor += specular;
-		break;
+		const float cosOfAngle{ Vector3::Dot(v.normal, toLight) };
+		if (cosOfAngle < 0.f) continue;
+		isLit = true;
 
-	case ShadingMode::Combined:
-		if (!m_ToApplyTransparency)
+		if constexpr (Mode == ShadingMode::ObservedArea)
 		{
-			finalColor += ambient + specular + diffuse * observedArea * lightIntensity;
+			observedArea += radiance * cosOfAngle;
 		}
-		else
+		if constexpr (Mode == ShadingMode::Diffuse || Mode == ShadingMode::Combined)
 		{
-			finalColor = diffuse;
+			diffuse += diffuseAlbedo * radiance * (cosOfAngle * light.intensity);
+		}
+		if constexpr (Mode == ShadingMode::Specular || Mode == ShadingMode::Combined)
+		{
+			// Specular is not scaled by the intensity, as in the original single light model
+			if (maxSpecular * std::max({ radiance.r, radiance.g, radiance.b }) < m_MinSpecularContribution) continue;
+			specular += Phong(specularColor, gloss * shininess, toLight, v.viewDirection, v.normal) * radiance;
 		}
-
-		break;
 	}
 
-	return finalColor;
+	// Surfaces no light reaches are black, ambient included
+	if (!isLit) return ColorRGB(0.f, 0.f, 0.f);
+
+	if constexpr (Mode == ShadingMode::ObservedArea)
+	{
+		return observedArea;
+	}
+	else if constexpr (Mode == ShadingMode::Diffuse)
+	{
+		return diffuse;
+	}
+	else if constexpr (Mode == ShadingMode::Specular)
+	{
+		return specular;
+	}
+	else
+	{
+		return ambient + specular + diffuse;
+	}
 }
 
 bool Mesh3D::CheckClipping(const Vector4& v0, const Vector4& v1, const Vector4& v2) const
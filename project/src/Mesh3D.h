@@ -8,6 +8,13 @@
 #include "DataTypes.h"
 #include "Camera.h"
 #include "Matrix.h"
+#include "PhongLookupTable.h"
+#include "LightGrid.h"
+#include "ShadingCache.h"
+#include "TransparencyBuffer.h"
+#include "PixelFormat.h"
+#include "FrameBuffer.h"
+#include "DepthFormat.h"
 using namespace dae;
 
 class Mesh3D final
@@ -22,12 +29,32 @@ public:
 	Mesh3D& operator=(Mesh3D&& rhs) = delete;
 
 	void RenderGPU(const Vector3& cameraPosition, const Matrix& pWorldMatrix, const Matrix& pWorldViewProjectionMatrix, ID3D11DeviceContext* pDeviceContext) const;
-	void RenderCPU(int width, int height, ShadingMode shadingMode, DisplayMode displayMode, CullingMode cullingMode, const Camera& camera, bool isNormalMap, SDL_Surface* pBackBuffer, uint32_t* pBackBufferPixels, float* pDepthBufferPixels) const;
+	// Blended meshes accumulate into pTransparencyBuffer, the caller composites it once the transparent draws are done.
+	// pFrameBuffer clears the tiles the draw touches, null when the depth buffer is not the frame buffer's own
+	void RenderCPU(int width, int height, ShadingMode shadingMode, DisplayMode displayMode, CullingMode cullingMode, const Camera& camera, const LightGrid& lightGrid, bool isNormalMap, FilteringTechnique filteringTechnique, SDL_Surface* pBackBuffer, const PixelFormat& backBufferFormat, uint32_t* pBackBufferPixels, void* pDepthBuffer, DepthFormat depthFormat, FrameBuffer* pFrameBuffer, TransparencyBuffer* pTransparencyBuffer = nullptr) const;
+
+	// Depth only, fills the depth buffer the light grid is built from; the shading pass then tests less-equal against it
+	void RenderDepthPrepassCPU(CullingMode cullingMode, const Camera& camera, FrameBuffer& frameBuffer) const;
 
 	void SetCullingMode(CullingMode cullingMode, ID3D11DeviceContext* context);
 
+	// Enables ShadingMode::Decoupled for this mesh, size is the atlas resolution and refreshPeriod how many frames
+	// a texel's shading may be reused while the lights stay put relative to the mesh
+	void EnableShadingCache(int size, int refreshPeriod);
+
+	// Output of the vertex stage, pipelined frames fill one off the render thread while the previous frame rasterizes
+	struct VertexStage
+	{
+		std::vector<Vertex_Out> vertices{};
+		Matrix objectToWorld{};
+		Vector3 objectCameraPosition{};
+	};
+
 	void VertexTransformationFunction(const Camera& camera, const Matrix& rotationMatrix);
-	ColorRGB PixelShading(Vertex_Out& v, ShadingMode shadingMode, bool isNormalMap, ColorRGB existingPixelColor = { 0.f, 0.f, 0.f}) const;
+	// Thread-safe against draws of this mesh, only the stage is written, on at most threadCount OpenMP threads
+	void TransformVertices(const Camera& camera, const Matrix& rotationMatrix, VertexStage& stage, int threadCount) const;
+	// The stage's vertices are drawn from now on, the stage gets the previous ones back so their storage is reused
+	void SwapVertexStage(VertexStage& stage);
 
 	bool CheckClipping(const Vector4& v0, const Vector4& v1, const Vector4& v2) const;
 	void ConvertToScreenSpace(float width, float height, Vector4& v0, Vector4& v1, Vector4& v2) const;
@@ -55,11 +82,145 @@ public:
 		const Vector3 reflect = l - (2 * std::max(Vector3::Dot(n, l), 0.f) * n);
 		const float cosAlpha = std::max(Vector3::Dot(reflect, v), 0.f);
 
-		return ks * std::powf(cosAlpha, exp);
+		return ks * PhongLookupTable::Get().Evaluate(cosAlpha, exp);
 	}
 
 	
 private:
+	// Per-draw state, resolved once so the kernels never call back into the effect
+	struct DrawContext
+	{
+		int width{};
+		int height{};
+		FilteringTechnique filteringTechnique{ FilteringTechnique::Anisotropic };
+
+		SDL_Surface* pBackBuffer{};
+		PixelFormat backBufferFormat{};
+		uint32_t* pBackBufferPixels{};
+		void* pDepthBuffer{};
+		FrameBuffer::Layout layout{};	// of the color, depth and transparency pixels, a pixel index is a storage index
+		DepthFormat depthFormat{ DepthFormat::Float32 };
+		float nearPlane{};
+		float farPlane{};
+		FrameBuffer* pFrameBuffer{};	// first touch of a tile clears it, null when the targets are cleared already
+		TransparencyBuffer* pTransparencyBuffer{};
+
+		const MaterialTexture* pMaterial{};
+		const Texture* pDiffuseTexture{};
+		const Texture* pSpecularTexture{};
+		const Texture* pGlossinessTexture{};
+
+		const LightGrid* pLightGrid{};
+		int lightGridScale{ 1 };	// light grid pixels per pixel of this draw, 2 for the downscaled fire
+		const Light* pLights{};		// the grid's lights moved into this mesh's object space, same indices
+
+		ShadingCache* pShadingCache{};
+	};
+
+	struct TriangleSetup
+	{
+		uint32_t t0{}, t1{}, t2{};
+		Vector4 v0{}, v1{}, v2{};	// screen space
+		int minX{}, maxX{}, minY{}, maxY{};
+	};
+
+	// Shading LOD: from this material mip on the normal map's detail is averaged away and the vertex normal is used
+	static constexpr float m_NormalMapMaxLod{ 4.f };
+	// Per light specular bounded below half an 8-bit step is skipped, Phong itself never exceeds 1
+	static constexpr float m_MinSpecularContribution{ .5f / 255.f };
+	// Gouraud reads gloss per vertex from this material mip, a vertex covers many texels anyway
+	static constexpr float m_VertexMaterialLod{ 4.f };
+
+	// What Rasterize interpolates besides depth
+	enum class Varyings
+	{
+		None,
+		Uv,					// uv only, without derivatives
+		PixelLighting,		// uv, normal, view direction and position
+		VertexLighting		// uv and the Gouraud lighting
+	};
+
+	// One instantiation per feature set, picked per draw from tables built in Mesh3D.cpp
+	using Kernel = void (Mesh3D::*)(const DrawContext& context) const;
+	struct KernelTable;
+
+	bool SetupTriangle(const DrawContext& context, int firstIndex, TriangleSetup& triangle) const;
+	void RenderBoundingBoxes(const DrawContext& context) const;
+
+	// MakeRowShader returns, per row, an object with Shade(pixelIndex, vertex, uvDdx, uvDdy) and Flush()
+	template<CullingMode Cull, bool DepthWrite, Varyings Interpolated, typename MakeRowShader>
+	void Rasterize(const DrawContext& context, const MakeRowShader& makeRowShader) const;
+
+	// Rasterize with the depth test compiled for one depth format
+	template<DepthFormat Format, CullingMode Cull, bool DepthWrite, Varyings Interpolated, typename MakeRowShader>
+	void RasterizeWithDepth(const DrawContext& context, const MakeRowShader& makeRowShader) const;
+
+	// Blended draws never write depth, so Blend decides that too
+	template<ShadingMode Mode, bool NormalMap, bool Blend, CullingMode Cull, bool UseMaterial>
+	void RenderShaded(const DrawContext& context) const;
+
+	// Gouraud: sums the lights into vertices_out once per draw, with the vertex normal
+	void LightVertices(const DrawContext& context) const;
+
+	// Decoupled: shades the cache texels seen last frame, with the same Combined model as ShadePixel
+	void UpdateShadingCache(const DrawContext& context, bool normalMap) const;
+
+	// Decoupled: the lit color of one cache texel, for the update and for texels the cache missed
+	ColorRGB ShadeCacheTexel(const DrawContext& context, const ShadingCache::Surface& surface, bool normalMap) const;
+
+	template<CullingMode Cull, bool DepthWrite>
+	void RenderDepth(const DrawContext& context) const;
+
+	template<CullingMode Cull>
+	void RenderDepthPrepass(const DrawContext& context) const;
+
+	// The light grid tile over a pixel index of the draw, decoded through the draw's own layout
+	static int GetLightTileIndex(const DrawContext& context, int pixelIndex);
+
+	template<ShadingMode Mode, bool NormalMap, bool Blend, bool UseMaterial>
+	// alpha is only written by blended draws
+	ColorRGB ShadePixel(const DrawContext& context, int pixelIndex, Vertex_Out& v, const Vector2& uvDdx, const Vector2& uvDdy, float& alpha) const;
+
+	// Structure-of-arrays varyings and material samples for 8 pixels of one row
+	struct PixelBatch
+	{
+		static constexpr int Lanes{ 8 };
+
+		int count{};
+		int tileIndex{};	// a batch never spans two light tiles
+		int pixelIndex[Lanes]{};
+		alignas(32) float normalX[Lanes]{};
+		alignas(32) float normalY[Lanes]{};
+		alignas(32) float normalZ[Lanes]{};
+		alignas(32) float viewX[Lanes]{};
+		alignas(32) float viewY[Lanes]{};
+		alignas(32) float viewZ[Lanes]{};
+		alignas(32) float positionX[Lanes]{};
+		alignas(32) float positionY[Lanes]{};
+		alignas(32) float positionZ[Lanes]{};
+		alignas(32) float diffuseR[Lanes]{};
+		alignas(32) float diffuseG[Lanes]{};
+		alignas(32) float diffuseB[Lanes]{};
+		alignas(32) float specularR[Lanes]{};
+		alignas(32) float specularG[Lanes]{};
+		alignas(32) float specularB[Lanes]{};
+		alignas(32) float gloss[Lanes]{};
+		alignas(32) float mapNormalX[Lanes]{};
+		alignas(32) float mapNormalY[Lanes]{};
+		alignas(32) float mapNormalZ[Lanes]{};
+	};
+
+	// Collects a row's pixels and shades them 8 wide with AVX2, only used for opaque material draws
+	template<ShadingMode Mode, bool NormalMap>
+	struct BatchRowShader
+	{
+		const DrawContext* pContext{};
+		PixelBatch batch{};
+
+		void Shade(int pixelIndex, Vertex_Out& pixelVertex, const Vector2& uvDdx, const Vector2& uvDdy);
+		void Flush();
+	};
+
 	uint32_t				m_NumIndices{};
 	Effect*					m_pEffect;
 
@@ -68,5 +229,10 @@ private:
 	ID3D11Buffer*			m_pIndexBuffer{};
 
 	std::unique_ptr<Mesh>	m_pUMesh{};
+	Matrix					m_ObjectToWorld{};	// rigid, so lights can be moved into object space instead of the varyings out of it
+	Vector3					m_ObjectCameraPosition{};
+	std::unique_ptr<ShadingCache> m_pUShadingCache{};
+	mutable std::vector<Light> m_ObjectLights{};	// per draw, kept so its storage is reused
+	VertexStage				m_VertexStage{};	// the back half of vertices_out when not pipelined
 	bool m_ToApplyTransparency; 
 };
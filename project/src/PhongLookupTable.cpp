@@ -0,0 +1,97 @@
+#include "PhongLookupTable.h"
+#include <algorithm>
+#include <cmath>
+
+namespace dae
+{
+	namespace
+	{
+		// Built during static initialization, before any frame is rendered
+		const PhongLookupTable g_PhongLookupTable{};
+	}
+
+	PhongLookupTable::PhongLookupTable() :
+		m_Table(size_t(ExponentCount) * (Segments + 1))
+	{
+		for (int row = 0; row < ExponentCount; ++row)
+		{
+			const float exponent = float(row) * MaxExponent / float(ExponentCount - 1);
+			for (int sample = 0; sample <= Segments; ++sample)
+			{
+				m_Table[size_t(row) * (Segments + 1) + sample] = std::pow(float(sample) / float(Segments), exponent);
+			}
+		}
+	}
+
+	const PhongLookupTable& PhongLookupTable::Get()
+	{
+		return g_PhongLookupTable;
+	}
+
+	float PhongLookupTable::Evaluate(float cosAlpha, float exponent) const
+	{
+		if (exponent < MinExponent || exponent > MaxExponent) return std::pow(cosAlpha, exponent);
+
+		const float rowPosition = exponent * float(ExponentCount - 1) / MaxExponent;
+		const int row = std::min(int(rowPosition), ExponentCount - 2);
+		const float rowFraction = rowPosition - float(row);
+
+		const float samplePosition = std::clamp(cosAlpha, 0.f, 1.f) * float(Segments);
+		const int sample = std::min(int(samplePosition), Segments - 1);
+		const float sampleFraction = samplePosition - float(sample);
+
+		const float* pRow0 = m_Table.data() + size_t(row) * (Segments + 1) + sample;
+		const float* pRow1 = pRow0 + (Segments + 1);
+
+		const float value0 = pRow0[0] + (pRow0[1] - pRow0[0]) * sampleFraction;
+		const float value1 = pRow1[0] + (pRow1[1] - pRow1[0]) * sampleFraction;
+		return value0 + (value1 - value0) * rowFraction;
+	}
+
+#if defined(__AVX2__)
+	__m256 PhongLookupTable::Evaluate8(__m256 cosAlpha, __m256 exponent) const
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.f);
+
+		// Out-of-range lanes still gather from a valid row and are patched afterwards
+		const __m256 clampedExponent = _mm256_min_ps(_mm256_max_ps(exponent, zero), _mm256_set1_ps(MaxExponent));
+		const __m256 rowPosition = _mm256_mul_ps(clampedExponent, _mm256_set1_ps(float(ExponentCount - 1) / MaxExponent));
+		const __m256i row = _mm256_min_epi32(_mm256_cvttps_epi32(rowPosition), _mm256_set1_epi32(ExponentCount - 2));
+		const __m256 rowFraction = _mm256_sub_ps(rowPosition, _mm256_cvtepi32_ps(row));
+
+		const __m256 samplePosition = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(cosAlpha, zero), one), _mm256_set1_ps(float(Segments)));
+		const __m256i sample = _mm256_min_epi32(_mm256_cvttps_epi32(samplePosition), _mm256_set1_epi32(Segments - 1));
+		const __m256 sampleFraction = _mm256_sub_ps(samplePosition, _mm256_cvtepi32_ps(sample));
+
+		const __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(row, _mm256_set1_epi32(Segments + 1)), sample);
+		const float* pTable = m_Table.data();
+		const __m256 value00 = _mm256_i32gather_ps(pTable, index, 4);
+		const __m256 value01 = _mm256_i32gather_ps(pTable + 1, index, 4);
+		const __m256 value10 = _mm256_i32gather_ps(pTable + (Segments + 1), index, 4);
+		const __m256 value11 = _mm256_i32gather_ps(pTable + (Segments + 2), index, 4);
+
+		const __m256 value0 = _mm256_fmadd_ps(_mm256_sub_ps(value01, value00), sampleFraction, value00);
+		const __m256 value1 = _mm256_fmadd_ps(_mm256_sub_ps(value11, value10), sampleFraction, value10);
+		__m256 result = _mm256_fmadd_ps(_mm256_sub_ps(value1, value0), rowFraction, value0);
+
+		const __m256 isOutOfRange = _mm256_or_ps(
+			_mm256_cmp_ps(exponent, _mm256_set1_ps(MinExponent), _CMP_LT_OQ),
+			_mm256_cmp_ps(exponent, _mm256_set1_ps(MaxExponent), _CMP_GT_OQ));
+		if (_mm256_movemask_ps(isOutOfRange) != 0)
+		{
+			alignas(32) float cosAlphas[8], exponents[8], results[8];
+			_mm256_store_ps(cosAlphas, cosAlpha);
+			_mm256_store_ps(exponents, exponent);
+			_mm256_store_ps(results, result);
+			for (int lane = 0; lane < 8; ++lane)
+			{
+				if (exponents[lane] < MinExponent || exponents[lane] > MaxExponent) results[lane] = std::pow(cosAlphas[lane], exponents[lane]);
+			}
+			result = _mm256_load_ps(results);
+		}
+
+		return result;
+	}
+#endif
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace dae
+{
+	// powf(cosAlpha, exponent) for the software Phong term, bilinear over 256 exponents x 256 cosAlpha segments.
+	// Max abs error against powf is 1.1e-3 for exponents in [1, 25] (worst near cosAlpha = 1, exponent 25),
+	// under half an 8-bit output step. Below exponent 1 the curve is too steep near 0 for a uniform grid
+	// (error reaches 0.9 at exponent ~0), so those and exponents above 25 fall back to powf.
+	class PhongLookupTable final
+	{
+	public:
+		static constexpr int ExponentCount{ 256 };
+		static constexpr int Segments{ 256 };
+		static constexpr float MinExponent{ 1.f };
+		static constexpr float MaxExponent{ 25.f };	// gloss * shininess, shininess is 25
+
+		PhongLookupTable();
+
+		static const PhongLookupTable& Get();
+
+		float Evaluate(float cosAlpha, float exponent) const;
+
+#if defined(__AVX2__)
+		// Eight lanes at once through gathers, same table and same powf fallback
+		__m256 Evaluate8(__m256 cosAlpha, __m256 exponent) const;
+#endif
+
+	private:
+		std::vector<float> m_Table{};	// ExponentCount rows of Segments + 1 samples
+	};
+}
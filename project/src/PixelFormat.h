@@ -0,0 +1,69 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include "SDL_surface.h"
+#include "ColorRGB.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace dae
+{
+	// Channel layout of the back buffer, resolved once per frame so pixel stores pack colors with shifts.
+	// Formats that are not 8 bits per channel in 32-bit pixels still go through SDL_MapRGB
+	struct PixelFormat
+	{
+		const SDL_PixelFormat* pFormat{};
+		bool isPacked{};
+		int redShift{};
+		int greenShift{};
+		int blueShift{};
+		uint32_t alphaMask{};
+
+		static PixelFormat Resolve(const SDL_PixelFormat* pFormat)
+		{
+			PixelFormat format{};
+			format.pFormat = pFormat;
+			format.isPacked = pFormat->BytesPerPixel == 4 && pFormat->Rloss == 0 && pFormat->Gloss == 0 && pFormat->Bloss == 0;
+			format.redShift = pFormat->Rshift;
+			format.greenShift = pFormat->Gshift;
+			format.blueShift = pFormat->Bshift;
+			format.alphaMask = pFormat->Amask;
+			return format;
+		}
+
+		// Channels are clamped to [0, 1] and truncated, like the SDL_MapRGB path always did
+		uint32_t Pack(const ColorRGB& color) const
+		{
+			const uint32_t r = uint32_t(std::min(std::max(color.r, 0.f), 1.f) * 255.f);
+			const uint32_t g = uint32_t(std::min(std::max(color.g, 0.f), 1.f) * 255.f);
+			const uint32_t b = uint32_t(std::min(std::max(color.b, 0.f), 1.f) * 255.f);
+			if (!isPacked) return SDL_MapRGB(pFormat, uint8_t(r), uint8_t(g), uint8_t(b));
+
+			return (r << redShift) | (g << greenShift) | (b << blueShift) | alphaMask;
+		}
+
+		// Channels already in 0-255, for blends that work in bytes
+		uint32_t PackBytes(uint32_t r, uint32_t g, uint32_t b) const
+		{
+			if (!isPacked) return SDL_MapRGB(pFormat, uint8_t(r), uint8_t(g), uint8_t(b));
+
+			return (r << redShift) | (g << greenShift) | (b << blueShift) | alphaMask;
+		}
+
+#if defined(__AVX2__)
+		// Only for packed formats, 8 pixels from structure-of-arrays channels
+		__m256i Pack8(__m256 r, __m256 g, __m256 b) const
+		{
+			auto toUnorm = [](__m256 value, int shift)
+				{
+					value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+					return _mm256_sll_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(value, _mm256_set1_ps(255.f))), _mm_cvtsi32_si128(shift));
+				};
+
+			return _mm256_or_si256(_mm256_or_si256(toUnorm(r, redShift), toUnorm(g, greenShift)),
+				_mm256_or_si256(toUnorm(b, blueShift), _mm256_set1_epi32(int(alphaMask))));
+		}
+#endif
+	};
+}
@@ -0,0 +1,116 @@
+#include "pch.h"
+#include "PresentQueue.h"
+#include <algorithm>
+
+namespace dae
+{
+	PresentQueue::PresentQueue(SDL_Window* pWindow, SDL_Surface* pWindowSurface, int width, int height, int bufferCount)
+		: m_pWindow{ pWindow }
+		, m_pWindowSurface{ pWindowSurface }
+		, m_IsInFlight(size_t(std::max(bufferCount, 2)), 0)
+	{
+		// Same channel layout as the window surface, so the copy is a plain one
+		const SDL_PixelFormat* pFormat = pWindowSurface->format;
+		const bool isWindowFormat = pFormat->BytesPerPixel == 4;
+		for (size_t i = 0; i < m_IsInFlight.size(); ++i)
+		{
+			m_Buffers.push_back(isWindowFormat
+				? SDL_CreateRGBSurface(0, width, height, 32, pFormat->Rmask, pFormat->Gmask, pFormat->Bmask, pFormat->Amask)
+				: SDL_CreateRGBSurface(0, width, height, 32, 0, 0, 0, 0));
+		}
+
+		m_Thread = std::thread{ &PresentQueue::CopyLoop, this };
+	}
+
+	PresentQueue::~PresentQueue()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			m_IsStopping = true;
+			// A frame copied but never shown is dropped, the copy thread may be waiting on it
+			m_IsAwaitingPresent = false;
+		}
+		m_SubmitCondition.notify_all();
+		m_PresentCondition.notify_all();
+		m_Thread.join();
+
+		for (SDL_Surface* pBuffer : m_Buffers)
+		{
+			SDL_FreeSurface(pBuffer);
+		}
+	}
+
+	SDL_Surface* PresentQueue::Acquire()
+	{
+		std::unique_lock<std::mutex> lock{ m_Mutex };
+		WaitPresenting(lock, [this]() { return !m_IsInFlight[m_NextBuffer]; });
+		return m_Buffers[m_NextBuffer];
+	}
+
+	void PresentQueue::Submit()
+	{
+		{
+			std::unique_lock<std::mutex> lock{ m_Mutex };
+			PresentCopied(lock);
+
+			m_IsInFlight[m_NextBuffer] = 1;
+			m_Submitted.push(m_NextBuffer);
+			m_NextBuffer = (m_NextBuffer + 1) % int(m_Buffers.size());
+		}
+		m_SubmitCondition.notify_one();
+	}
+
+	void PresentQueue::Flush()
+	{
+		std::unique_lock<std::mutex> lock{ m_Mutex };
+		WaitPresenting(lock, [this]()
+			{
+				return !m_IsAwaitingPresent && std::none_of(m_IsInFlight.begin(), m_IsInFlight.end(), [](uint8_t isInFlight) { return isInFlight != 0; });
+			});
+	}
+
+	void PresentQueue::PresentCopied(std::unique_lock<std::mutex>& lock)
+	{
+		if (!m_IsAwaitingPresent) return;
+
+		// The copy thread leaves the window surface alone until the flag is cleared
+		lock.unlock();
+		SDL_UpdateWindowSurface(m_pWindow);
+		lock.lock();
+
+		m_IsAwaitingPresent = false;
+		m_PresentCondition.notify_all();
+	}
+
+	void PresentQueue::CopyLoop()
+	{
+		while (true)
+		{
+			int bufferIndex{};
+			{
+				std::unique_lock<std::mutex> lock{ m_Mutex };
+				m_SubmitCondition.wait(lock, [this]() { return m_IsStopping || !m_Submitted.empty(); });
+
+				// Copy what was submitted before stopping, Flush may be waiting on it
+				if (m_Submitted.empty()) return;
+
+				bufferIndex = m_Submitted.front();
+				m_Submitted.pop();
+
+				// The window surface still holds the previous frame until the main thread has shown it
+				m_PresentCondition.wait(lock, [this]() { return m_IsStopping || !m_IsAwaitingPresent; });
+				if (m_IsStopping) return;
+			}
+
+			// A surface blit, no window or video call happens on this thread
+			SDL_BlitSurface(m_Buffers[bufferIndex], nullptr, m_pWindowSurface, nullptr);
+
+			{
+				std::lock_guard<std::mutex> lock{ m_Mutex };
+				m_IsInFlight[bufferIndex] = 0;
+				m_IsAwaitingPresent = true;
+			}
+			m_PresentCondition.notify_all();
+		}
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+struct SDL_Surface;
+struct SDL_Window;
+
+namespace dae
+{
+	// Ring of back buffers copied into the window surface on a thread of its own, so the next frame renders
+	// while the previous one is copied. SDL only supports its window functions on the main thread, so the
+	// copied frame is shown by SDL_UpdateWindowSurface from the calls below, which must come from that thread.
+	// At most bufferCount - 1 frames wait for present
+	class PresentQueue final
+	{
+	public:
+		PresentQueue(SDL_Window* pWindow, SDL_Surface* pWindowSurface, int width, int height, int bufferCount);
+		~PresentQueue();
+
+		PresentQueue(const PresentQueue&) = delete;
+		PresentQueue(PresentQueue&&) noexcept = delete;
+		PresentQueue& operator=(const PresentQueue&) = delete;
+		PresentQueue& operator=(PresentQueue&&) noexcept = delete;
+
+		// The next buffer of the ring, blocks until its previous frame has been copied out
+		SDL_Surface* Acquire();
+
+		// Queues the buffer of the last Acquire for present, and shows the previous frame if it was copied meanwhile
+		void Submit();
+
+		// Blocks until every submitted frame is on screen, before anything else draws to the window
+		void Flush();
+
+	private:
+		SDL_Window* m_pWindow{};
+		SDL_Surface* m_pWindowSurface{};
+
+		std::vector<SDL_Surface*> m_Buffers{};
+		std::vector<uint8_t> m_IsInFlight{};	// submitted and not presented yet, the fence Acquire and Flush wait on
+		int m_NextBuffer{};
+
+		std::queue<int> m_Submitted{};
+		std::mutex m_Mutex{};
+		std::condition_variable m_SubmitCondition{};
+		std::condition_variable m_PresentCondition{};
+		bool m_IsAwaitingPresent{ false };	// the window surface holds a copied frame the main thread has not shown yet
+		bool m_IsStopping{ false };
+
+		std::thread m_Thread{};
+
+		void CopyLoop();
+		// Shows a copied frame, if any, on the calling main thread; the lock is released around the SDL call
+		void PresentCopied(std::unique_lock<std::mutex>& lock);
+		// Waits for the condition, presenting copied frames meanwhile so the copy thread never stalls on one
+		template<typename Condition>
+		void WaitPresenting(std::unique_lock<std::mutex>& lock, Condition condition)
+		{
+			while (!condition())
+			{
+				if (m_IsAwaitingPresent)
+				{
+					PresentCopied(lock);
+					continue;
+				}
+				m_PresentCondition.wait(lock);
+			}
+		}
+	};
+}
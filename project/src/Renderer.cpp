@@ -1,7 +1,7 @@
 #include "pch.h"
 #include "Renderer.h"
 #include "Mesh3D.h"
-#include "Utils.h"
+#include "AssetLoader.h"
 
 const std::string MAGENTA = "\033[35m";
 const std::string YELLOW = "\033[33m";
@@ -24,16 +24,51 @@ namespace dae {
 
 			// Create Buffers
 			m_pFrontBuffer = SDL_GetWindowSurface(pWindow);
-			m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
-			m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
 
-			m_pDepthBufferPixels = new float[m_Width * m_Height];
+			// The software path draws straight into the window surface when it can address it as packed 32-bit rows,
+			// presenting is then only SDL_UpdateWindowSurface; otherwise it draws into its own surface and blits
+			m_IsZeroCopyPresent = m_pFrontBuffer != nullptr && m_pFrontBuffer->w == m_Width && m_pFrontBuffer->h == m_Height
+				&& m_pFrontBuffer->format->BytesPerPixel == 4 && m_pFrontBuffer->pitch == m_Width * 4;
+			m_pBackBuffer = m_IsZeroCopyPresent ? m_pFrontBuffer : SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
+			m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
 
+			m_pFrameBuffer = std::make_unique<FrameBuffer>(m_Width, m_Height, m_pBackBufferPixels);
+			m_pPresentQueue = std::make_unique<PresentQueue>(pWindow, m_pFrontBuffer, m_Width, m_Height, m_PresentBufferCount);
+			m_pTransparencyBuffer = std::make_unique<TransparencyBuffer>(m_Width, m_Height);
+			m_pHalfResolutionTransparencyBuffer = std::make_unique<TransparencyBuffer>(m_Width, m_Height, 2);
+
+			// Decode and parse every asset concurrently
+			AssetLoader assetLoader{};
+			auto vehicleMesh = assetLoader.LoadMesh("resources/vehicle.obj");
+			auto fireMesh = assetLoader.LoadMesh("resources/fireFX.obj");
+			auto vehicleDiffuse = assetLoader.LoadTexture("resources/vehicle_diffuse.png", TextureFormat::BC1);
+			auto vehicleNormal = assetLoader.LoadTexture("resources/vehicle_normal.png", TextureFormat::BC5);
+			auto vehicleSpecular = assetLoader.LoadTexture("resources/vehicle_specular.png", TextureFormat::BC1);
+			auto vehicleGloss = assetLoader.LoadTexture("resources/vehicle_gloss.png", TextureFormat::BC1);
+			auto fireDiffuse = assetLoader.LoadTexture("resources/fireFX_diffuse.png", TextureFormat::BC3);
+
+			// Effects compile on this thread while the workers decode, GPU uploads stay here as well
 			m_pVehicleEffect = std::make_unique<VehicleEffect>(m_pDevice, L"resources/PosCol3D.fx");
-			InitializeVehicle();
-
 			m_pFireEffect = std::make_unique<FireEffect>(m_pDevice, L"resources/Fire3D.fx");
-			InitializeFire();
+
+			m_pVehicleEffect->SetMaps(
+				std::make_unique<Texture>(m_pDevice, vehicleDiffuse.get()),
+				std::make_unique<Texture>(m_pDevice, vehicleNormal.get()),
+				std::make_unique<Texture>(m_pDevice, vehicleSpecular.get()),
+				std::make_unique<Texture>(m_pDevice, vehicleGloss.get()));
+			m_pFireEffect->SetDiffuseMap(std::make_unique<Texture>(m_pDevice, fireDiffuse.get()));
+
+			// The vehicle is rigid, so its normals are baked to object space before the material is paged
+			const MeshData vehicleMeshData = vehicleMesh.get();
+			m_pVehicleEffect->GetMaterial()->BakeObjectSpaceNormals(vehicleMeshData.vertices, vehicleMeshData.indices);
+
+			// Only what the software rasterizer samples is paged, the GPU keeps its own copies
+			m_pPageCache = std::make_unique<PageCache>(m_VirtualTextureBudget);
+			m_pVehicleEffect->GetMaterial()->Virtualize(m_pPageCache.get());
+			m_pFireEffect->GetDiffuseTexture()->Virtualize(m_pPageCache.get());
+
+			InitializeVehicle(vehicleMeshData);
+			InitializeFire(fireMesh.get());
 
 			m_pCamera = std::make_unique<Camera>(Vector3{ 0.f, 0.f , -50.f }, 45.f, float(m_Width), float(m_Height));
 		}
@@ -41,7 +76,14 @@ namespace dae {
 
 	Renderer::~Renderer()
 	{
-		delete m_pDepthBufferPixels;
+		// The vertex jobs write into the meshes' stages
+		FlushPipelinedFrames();
+
+		// Joins the copy thread before the surfaces it reads go away
+		m_pPresentQueue.reset();
+
+		// The window owns its surface
+		if (!m_IsZeroCopyPresent) SDL_FreeSurface(m_pBackBuffer);
 		CleanupDirectX();
 	}
 
@@ -59,8 +101,15 @@ namespace dae {
 		// Apply transformations
 		if (m_RenderingBackendType == RenderingBackendType::Software)
 		{
+			if (m_IsPipelined)
+			{
+				UpdatePipelined();
+				return;
+			}
+
 			m_pVehicle->VertexTransformationFunction(*m_pCamera.get(), m_WorldMatrix);
 			m_pFire->VertexTransformationFunction(*m_pCamera.get(), m_WorldMatrix);
+			m_DrawCamera = *m_pCamera.get();
 		}
 			
 	}
@@ -100,9 +149,6 @@ namespace dae {
 
 	void Renderer::RenderCPU() const
 	{
-		// Reset depth buffer and clear screen
-		std::fill(m_pDepthBufferPixels, m_pDepthBufferPixels + (m_Width * m_Height), std::numeric_limits<float>::max());
-
 		// Clear screen with black color
 		SDL_Color clearColor;
 		if (m_IsClearColorUniform) 
@@ -114,26 +160,72 @@ namespace dae {
 			clearColor = { int(0.39f * 255),  int(0.39f * 255),  int(0.39f * 255), 255 };
 		}
 
-		Uint32 color = SDL_MapRGB(m_pBackBuffer->format, clearColor.r, clearColor.g, clearColor.b);
-		SDL_FillRect(m_pBackBuffer, nullptr, color);
+		// Asynchronous present draws into the next free buffer of its ring, otherwise the frame goes to the back buffer
+		SDL_Surface* pBackBuffer = m_IsAsyncPresent ? m_pPresentQueue->Acquire() : m_pBackBuffer;
+		m_pFrameBuffer->SetPresentPixels(static_cast<uint32_t*>(pBackBuffer->pixels));
+		// The draws write the frame buffer's tiles, ResolveColor detiles them into the back buffer
+		uint32_t* pBackBufferPixels = m_pFrameBuffer->GetColorPixels();
+
+		// The channel layout is resolved once, every draw and the composite pack with it
+		const PixelFormat backBufferFormat = PixelFormat::Resolve(pBackBuffer->format);
 
-		// Lock the back buffer before drawing
-		SDL_LockSurface(m_pBackBuffer);
+		// Only marks the tiles, the draws clear what they touch and the rest gets the clear color before the blit
+		Uint32 color = SDL_MapRGB(pBackBuffer->format, clearColor.r, clearColor.g, clearColor.b);
+		m_pFrameBuffer->Clear(color);
+
+		// Lock the back buffer before drawing, window and software surfaces normally need no lock
+		const bool mustLock = SDL_MUSTLOCK(pBackBuffer);
+		if (mustLock) SDL_LockSurface(pBackBuffer);
 
 		// RENDER LOGIC
-		m_pVehicle.get()->RenderCPU(m_Width, m_Height, m_CurrentShadingMode, m_CurrentDisplayMode, m_CullingMode, *m_pCamera.get(), m_IsNormalMap, m_pBackBuffer, m_pBackBufferPixels, m_pDepthBufferPixels);
+		if (m_CurrentDisplayMode == DisplayMode::ShadingMode)
+		{
+			// Gouraud lights per vertex and Decoupled per cache texel, only the other modes read the tiles;
+			// directional lights reach every tile, so without point or spot lights there is nothing to cull
+			const bool readsLightTiles = m_CurrentShadingMode != ShadingMode::Gouraud && m_CurrentShadingMode != ShadingMode::Decoupled;
+			const bool hasLocalLights = std::any_of(m_Lights.begin(), m_Lights.end(), [](const Light& light) { return light.type != LightType::Directional; });
+			if (readsLightTiles && hasLocalLights)
+			{
+				// Opaque depth first, so lights are culled against it and every covered pixel is shaded once
+				m_pVehicle.get()->RenderDepthPrepassCPU(m_CullingMode, m_DrawCamera, *m_pFrameBuffer.get());
+				m_pLightGrid->Build(m_Lights, m_DrawCamera, *m_pFrameBuffer.get());
+			}
+			else
+			{
+				m_pLightGrid->BuildUnculled(m_Lights, m_Width, m_Height);
+			}
+		}
+
+		m_pVehicle.get()->RenderCPU(m_Width, m_Height, m_CurrentShadingMode, m_CurrentDisplayMode, m_CullingMode, m_DrawCamera, *m_pLightGrid.get(), m_IsNormalMap, m_FilteringTechnique, pBackBuffer, backBufferFormat, pBackBufferPixels, m_pFrameBuffer->GetDepthPixels(), m_pFrameBuffer->GetDepthFormat(), m_pFrameBuffer.get());
 		if (m_ToRenderFireMesh)
 		{
 			if (m_CurrentShadingMode == ShadingMode::Combined && m_CurrentDisplayMode == DisplayMode::ShadingMode)
 			{
-				m_pFire.get()->RenderCPU(m_Width, m_Height, m_CurrentShadingMode, m_CurrentDisplayMode, CullingMode::No, *m_pCamera.get(), false, m_pBackBuffer, m_pBackBufferPixels, m_pDepthBufferPixels);
+				// The fire is unlit in Combined, so drawing it at the layers' resolution never reads the full resolution light grid.
+				// Its downsampled depth is a buffer of its own, the composite touches the frame buffer tiles it blends into
+				TransparencyBuffer* pTransparencyBuffer = m_IsHalfResolutionTransparency ? m_pHalfResolutionTransparencyBuffer.get() : m_pTransparencyBuffer.get();
+				FrameBuffer* pFrameBuffer = m_IsHalfResolutionTransparency ? nullptr : m_pFrameBuffer.get();
+				m_pFire.get()->RenderCPU(pTransparencyBuffer->GetWidth(), pTransparencyBuffer->GetHeight(), m_CurrentShadingMode, m_CurrentDisplayMode, CullingMode::No, m_DrawCamera, *m_pLightGrid.get(), false, m_FilteringTechnique, pBackBuffer, backBufferFormat, pBackBufferPixels, pTransparencyBuffer->DownsampleDepth(*m_pFrameBuffer.get()), m_pFrameBuffer->GetDepthFormat(), pFrameBuffer, pTransparencyBuffer);
+				pTransparencyBuffer->Composite(backBufferFormat, *m_pFrameBuffer.get(), m_DrawCamera.nearPlane, m_DrawCamera.farPlane);
 			}
 		}
+		m_pFrameBuffer->ResolveColor();
+
 		// Unlock after rendering
-		SDL_UnlockSurface(m_pBackBuffer);
+		if (mustLock) SDL_UnlockSurface(pBackBuffer);
+
+		// Stream in the pages this frame missed, shading is done so the page tables can change
+		m_pPageCache->ResolveFeedback();
+
+		// The copy thread moves the frame into the window surface while the next one renders, the next Submit shows it
+		if (m_IsAsyncPresent)
+		{
+			m_pPresentQueue->Submit();
+			return;
+		}
 
-		// Copy the back buffer to the front buffer for display
-		SDL_BlitSurface(m_pBackBuffer, nullptr, m_pFrontBuffer, nullptr);
+		// Copy the back buffer to the front buffer for display, unless the frame was drawn into it
+		if (!m_IsZeroCopyPresent) SDL_BlitSurface(pBackBuffer, nullptr, m_pFrontBuffer, nullptr);
 		SDL_UpdateWindowSurface(m_pWindow);
 	}
 
@@ -142,6 +234,14 @@ namespace dae {
 		switch (m_CurrentShadingMode)
 		{
 		case ShadingMode::Combined:
+			std::cout << MAGENTA << "**(SOFTWARE) Shading Mode = GOURAUD" << RESET << std::endl;
+			m_CurrentShadingMode = ShadingMode::Gouraud;
+			break;
+		case ShadingMode::Gouraud:
+			std::cout << MAGENTA << "**(SOFTWARE) Shading Mode = DECOUPLED" << RESET << std::endl;
+			m_CurrentShadingMode = ShadingMode::Decoupled;
+			break;
+		case ShadingMode::Decoupled:
 			std::cout << MAGENTA << "**(SOFTWARE) Shading Mode = OBSERVED_AREA" << RESET << std::endl;
 			m_CurrentShadingMode = ShadingMode::ObservedArea;
 			break;
@@ -176,19 +276,19 @@ namespace dae {
 		{
 		case FilteringTechnique::Point:
 			m_pVehicleEffect->SetLinearSampling();
-			std::cout << GREEN << "**(HARDWARE) Sampler Filter = LINEAR" << RESET << std::endl;
+			std::cout << YELLOW << "**(SHARED) Sampler Filter = LINEAR" << RESET << std::endl;
 
 			m_FilteringTechnique = FilteringTechnique::Linear;
 			break;
 		case FilteringTechnique::Linear:
 			m_pVehicleEffect->SetAnisotropicSampling();
-			std::cout << GREEN << "**(HARDWARE) Sampler Filter = ANISOTROPIC" << RESET << std::endl;
+			std::cout << YELLOW << "**(SHARED) Sampler Filter = ANISOTROPIC" << RESET << std::endl;
 
 			m_FilteringTechnique = FilteringTechnique::Anisotropic;
 			break;
 		case FilteringTechnique::Anisotropic:
 			m_pVehicleEffect->SetPointSampling();
-			std::cout << GREEN << "**(HARDWARE) Sampler Filter = POINT" << RESET << std::endl;
+			std::cout << YELLOW << "**(SHARED) Sampler Filter = POINT" << RESET << std::endl;
 
 			m_FilteringTechnique = FilteringTechnique::Point;
 			break;
@@ -200,6 +300,9 @@ namespace dae {
 		switch (m_RenderingBackendType)
 		{
 		case RenderingBackendType::Software:
+			// The swap chain takes over the window, no software frame may still be on its way to it
+			m_pPresentQueue->Flush();
+			FlushPipelinedFrames();
 			std::cout << YELLOW << "**(SHARED)Rasterizer Mode = HARDWARE" << RESET << std::endl;
 			m_RenderingBackendType = RenderingBackendType::Hardware;
 			break;
@@ -289,6 +392,181 @@ namespace dae {
 		m_pFire->SetCullingMode(CullingMode::No, m_pDeviceContext);
 	}
 
+	void Renderer::ChangeIsPointLights()
+	{
+		m_IsPointLights = !m_IsPointLights;
+		m_Lights.resize(1);
+
+		if (m_IsPointLights)
+		{
+			// Ring of colored point lights around the vehicle, with a few spots pointing at it from above
+			constexpr int pointLightCount{ 64 };
+			constexpr int spotLightCount{ 8 };
+			for (int i = 0; i < pointLightCount; ++i)
+			{
+				const float angle = float(i) / pointLightCount * 2.f * PI;
+				Light light{};
+				light.type = LightType::Point;
+				light.position = { std::cos(angle) * 18.f, (i % 2 == 0) ? -2.f : 6.f, std::sin(angle) * 18.f };
+				light.color = { .5f + .5f * std::cos(angle), .5f + .5f * std::cos(angle + 2.094f), .5f + .5f * std::cos(angle + 4.189f) };
+				light.intensity = 40.f;
+				light.range = 10.f;
+				m_Lights.push_back(light);
+			}
+			for (int i = 0; i < spotLightCount; ++i)
+			{
+				const float angle = float(i) / spotLightCount * 2.f * PI;
+				Light light{};
+				light.type = LightType::Spot;
+				light.position = { std::cos(angle) * 12.f, 15.f, std::sin(angle) * 12.f };
+				light.direction = (-light.position).Normalized();
+				light.intensity = 200.f;
+				light.range = 30.f;
+				m_Lights.push_back(light);
+			}
+
+			std::cout << MAGENTA << "**(SOFTWARE) Point Lights ON (" << m_Lights.size() << " lights)" << RESET << std::endl;
+		}
+		else
+		{
+			std::cout << MAGENTA << "**(SOFTWARE) Point Lights OFF" << RESET << std::endl;
+		}
+	}
+
+	void Renderer::ChangeIsHalfResolutionTransparency()
+	{
+		m_IsHalfResolutionTransparency = !m_IsHalfResolutionTransparency;
+
+		if (m_IsHalfResolutionTransparency)
+		{
+			std::cout << MAGENTA << "**(SOFTWARE) Half Resolution FireFX ON" << RESET << std::endl;
+		}
+		else
+		{
+			std::cout << MAGENTA << "**(SOFTWARE) Half Resolution FireFX OFF" << RESET << std::endl;
+		}
+	}
+
+	void Renderer::ChangeIsAsyncPresent()
+	{
+		// Zero-copy present draws into the window surface itself, the ring must be done with it first
+		m_pPresentQueue->Flush();
+		m_IsAsyncPresent = !m_IsAsyncPresent;
+
+		if (m_IsAsyncPresent)
+		{
+			std::cout << MAGENTA << "**(SOFTWARE) Async Present ON" << RESET << std::endl;
+		}
+		else
+		{
+			std::cout << MAGENTA << "**(SOFTWARE) Async Present OFF" << RESET << std::endl;
+		}
+	}
+
+	void Renderer::ChangeIsPipelined()
+	{
+		// Serial frames transform into the meshes' own stages again, the jobs must be done with theirs
+		FlushPipelinedFrames();
+		m_IsPipelined = !m_IsPipelined;
+
+		if (m_IsPipelined)
+		{
+			std::cout << MAGENTA << "**(SOFTWARE) Pipelined Frames ON" << RESET << std::endl;
+		}
+		else
+		{
+			std::cout << MAGENTA << "**(SOFTWARE) Pipelined Frames OFF" << RESET << std::endl;
+		}
+	}
+
+	void Renderer::UpdatePipelined()
+	{
+		// Start this frame's vertex stage, its camera is kept with it so the raster sees the state the vertices were made with
+		PipelinedFrame& newFrame = m_PipelinedFrames[(m_OldestPipelinedFrame + m_PipelinedFrameCount) % m_MaxFramesInFlight];
+		newFrame.camera = *m_pCamera.get();
+		newFrame.vertexStage = m_VertexStagePool.Submit([this, &newFrame, worldMatrix = m_WorldMatrix]()
+			{
+				m_pVehicle->TransformVertices(newFrame.camera, worldMatrix, newFrame.vehicleStage, m_VertexStageThreadCount);
+				m_pFire->TransformVertices(newFrame.camera, worldMatrix, newFrame.fireStage, m_VertexStageThreadCount);
+			});
+		++m_PipelinedFrameCount;
+
+		// Render draws the oldest frame while the younger ones transform; a pipeline that was just started has nothing
+		// on screen yet, so its first frame is waited for
+		while (m_PipelinedFrameCount >= m_MaxFramesInFlight || !m_IsPipelinePrimed)
+		{
+			ApplyOldestPipelinedFrame();
+			m_IsPipelinePrimed = true;
+		}
+	}
+
+	void Renderer::ApplyOldestPipelinedFrame()
+	{
+		PipelinedFrame& frame = m_PipelinedFrames[m_OldestPipelinedFrame];
+		frame.vertexStage.get();
+
+		m_pVehicle->SwapVertexStage(frame.vehicleStage);
+		m_pFire->SwapVertexStage(frame.fireStage);
+		m_DrawCamera = frame.camera;
+
+		m_OldestPipelinedFrame = (m_OldestPipelinedFrame + 1) % m_MaxFramesInFlight;
+		--m_PipelinedFrameCount;
+	}
+
+	void Renderer::FlushPipelinedFrames()
+	{
+		// Applied in order, the meshes end up with the newest frame's vertices
+		while (m_PipelinedFrameCount > 0)
+		{
+			ApplyOldestPipelinedFrame();
+		}
+		m_IsPipelinePrimed = false;
+	}
+
+	void Renderer::ChangeFramesInFlight()
+	{
+		SetFramesInFlight(m_MaxFramesInFlight % m_MaxFramesInFlightLimit + 1);
+		std::cout << MAGENTA << "**(SOFTWARE) Frames In Flight = " << m_MaxFramesInFlight << RESET << std::endl;
+	}
+
+	void Renderer::SetFramesInFlight(int framesInFlight)
+	{
+		framesInFlight = std::clamp(framesInFlight, 1, m_MaxFramesInFlightLimit);
+		if (framesInFlight == m_MaxFramesInFlight) return;
+
+		// The jobs in flight hold references into the ring, it is only resized once they are done
+		FlushPipelinedFrames();
+		m_MaxFramesInFlight = framesInFlight;
+		m_PipelinedFrames = std::vector<PipelinedFrame>(size_t(m_MaxFramesInFlight));
+		m_OldestPipelinedFrame = 0;
+	}
+
+	void Renderer::SetVertexStageThreadCount(int threadCount)
+	{
+		// Read by the jobs in flight
+		FlushPipelinedFrames();
+		m_VertexStageThreadCount = std::max(threadCount, 1);
+	}
+
+	void Renderer::ChangeDepthFormat()
+	{
+		switch (m_pFrameBuffer->GetDepthFormat())
+		{
+		case DepthFormat::Float32:
+			m_pFrameBuffer->SetDepthFormat(DepthFormat::Unorm16);
+			std::cout << MAGENTA << "**(SOFTWARE) Depth Format = UNORM16" << RESET << std::endl;
+			break;
+		case DepthFormat::Unorm16:
+			m_pFrameBuffer->SetDepthFormat(DepthFormat::ReversedFloat32);
+			std::cout << MAGENTA << "**(SOFTWARE) Depth Format = REVERSED_FLOAT32" << RESET << std::endl;
+			break;
+		case DepthFormat::ReversedFloat32:
+			m_pFrameBuffer->SetDepthFormat(DepthFormat::Float32);
+			std::cout << MAGENTA << "**(SOFTWARE) Depth Format = FLOAT32" << RESET << std::endl;
+			break;
+		}
+	}
+
 	void Renderer::OnDeviceLost()
 	{
 		// Release all resources tied to the device
@@ -298,30 +576,23 @@ namespace dae {
 		InitializeDirectX();
 
 		// Recreate resources
-		InitializeVehicle();
-		InitializeFire();
+		AssetLoader assetLoader{};
+		auto vehicleMesh = assetLoader.LoadMesh("resources/vehicle.obj");
+		auto fireMesh = assetLoader.LoadMesh("resources/fireFX.obj");
+		InitializeVehicle(vehicleMesh.get());
+		InitializeFire(fireMesh.get());
 
 	}
 	
-	void Renderer::InitializeVehicle()
+	void Renderer::InitializeVehicle(const MeshData& meshData)
 	{
-		//Create some data for our mesh
-		std::vector<Vertex> vertices;
-		std::vector<uint32_t> indices;
-		
-		Utils::ParseOBJ("resources/vehicle.obj", vertices, indices);
-
-		m_pVehicle = std::make_unique<Mesh3D>(m_pDevice, vertices, indices, m_pVehicleEffect.get(), false);
+		m_pVehicle = std::make_unique<Mesh3D>(m_pDevice, meshData.vertices, meshData.indices, m_pVehicleEffect.get(), false);
+		m_pVehicle->EnableShadingCache(m_ShadingCacheSize, m_ShadingCacheRefreshPeriod);
 	}
 
-	void Renderer::InitializeFire()
+	void Renderer::InitializeFire(const MeshData& meshData)
 	{
-		std::vector<Vertex> vertices;
-		std::vector<uint32_t> indices;
-
-		Utils::ParseOBJ("resources/fireFX.obj", vertices, indices);
-
-		m_pFire = std::make_unique<Mesh3D>(m_pDevice, vertices, indices, m_pFireEffect.get(), true);
+		m_pFire = std::make_unique<Mesh3D>(m_pDevice, meshData.vertices, meshData.indices, m_pFireEffect.get(), true);
 	}
 
 
@@ -4,6 +4,9 @@
 #include "Camera.h"
 #include "FireEffect.h"
 #include "DataTypes.h"
+#include "AssetLoader.h"
+#include "PresentQueue.h"
+#include "ThreadPool.h"
 
 struct SDL_Window;
 struct SDL_Surface;
@@ -37,6 +40,16 @@ namespace dae
 		void ChangeIsNormalMap();
 		void ChangeIsClearColorUniform();
 		void ChangeCullingMode();
+		void ChangeIsPointLights();
+		void ChangeIsHalfResolutionTransparency();
+		void ChangeDepthFormat();
+		void ChangeIsAsyncPresent();
+		void ChangeIsPipelined();
+		void ChangeFramesInFlight();
+		// Pipelined frames: 1 runs the vertex stage and the raster one after the other, each extra frame adds a frame of latency
+		void SetFramesInFlight(int framesInFlight);
+		// OpenMP threads the pipelined vertex stage may use, the raster keeps the rest
+		void SetVertexStageThreadCount(int threadCount);
 	private:
 		SDL_Window* m_pWindow{};
 
@@ -62,9 +75,18 @@ namespace dae
 		
 		//Software initialization
 		SDL_Surface* m_pFrontBuffer{ nullptr };
-		SDL_Surface* m_pBackBuffer{ nullptr };
+		SDL_Surface* m_pBackBuffer{ nullptr };		// the front buffer itself when presenting without a copy
+		bool m_IsZeroCopyPresent{ false };
+
+		// Double buffered, the renderer runs at most one frame ahead of the screen
+		static constexpr int m_PresentBufferCount{ 2 };
+		std::unique_ptr<PresentQueue> m_pPresentQueue;
+		bool m_IsAsyncPresent{ false };
 		uint32_t* m_pBackBufferPixels{};
-		float* m_pDepthBufferPixels{};
+		std::unique_ptr<FrameBuffer> m_pFrameBuffer;	// the back buffer's pixels and the depth buffer, cleared per tile on first touch
+		std::unique_ptr<TransparencyBuffer> m_pTransparencyBuffer;	// the fire's layers, composited after it is drawn
+		std::unique_ptr<TransparencyBuffer> m_pHalfResolutionTransparencyBuffer;
+		bool m_IsHalfResolutionTransparency{ false };
 
 
 		//MESH
@@ -73,6 +95,30 @@ namespace dae
 		std::unique_ptr<Mesh3D> m_pFire;
 
 		std::unique_ptr<Camera> m_pCamera;
+		Camera m_DrawCamera{};	// the camera the drawn vertices were transformed with, behind m_pCamera when pipelined
+
+		// Pipelined frames: the vertex stage of the next frames runs on a few threads while the oldest one rasterizes.
+		// The frames-in-flight limit bounds the added latency, the default 2 keeps the screen one frame behind the input
+		struct PipelinedFrame
+		{
+			Camera camera{};
+			Mesh3D::VertexStage vehicleStage{};
+			Mesh3D::VertexStage fireStage{};
+			std::future<void> vertexStage{};
+		};
+		static constexpr int m_MaxFramesInFlightLimit{ 3 };
+		int m_MaxFramesInFlight{ 2 };
+		int m_VertexStageThreadCount{ int(std::max(std::thread::hardware_concurrency() / 4, 1u)) };
+		std::vector<PipelinedFrame> m_PipelinedFrames{ size_t(m_MaxFramesInFlight) };
+		int m_OldestPipelinedFrame{};
+		int m_PipelinedFrameCount{};
+		bool m_IsPipelinePrimed{ false };
+		bool m_IsPipelined{ false };
+		ThreadPool m_VertexStagePool{ 1 };	// declared after the frames and meshes, so it drains before they go away
+
+		void UpdatePipelined();
+		void ApplyOldestPipelinedFrame();
+		void FlushPipelinedFrames();
 		FilteringTechnique m_FilteringTechnique{ FilteringTechnique::Anisotropic };
 		RenderingBackendType m_RenderingBackendType{ RenderingBackendType::Hardware };
 		ShadingMode m_CurrentShadingMode{ ShadingMode::Combined };
@@ -85,10 +131,23 @@ namespace dae
 
 		bool m_IsClearColorUniform{ false };
 
+		// Software lights, the first one is the original directional light; the grid is rebuilt every frame
+		std::vector<Light> m_Lights{ Light{} };
+		bool m_IsPointLights{ false };
+		std::unique_ptr<LightGrid> m_pLightGrid{ std::make_unique<LightGrid>() };
+
+		// Texture-space lighting for ShadingMode::Decoupled, reused for this many frames while the vehicle stands still
+		static constexpr int m_ShadingCacheSize{ 1024 };
+		static constexpr int m_ShadingCacheRefreshPeriod{ 4 };
+
+		// Residency budget for the software sampler's textures, declared before the effects so it outlives them
+		static constexpr size_t m_VirtualTextureBudget{ 32 * 1024 * 1024 };
+		std::unique_ptr<PageCache> m_pPageCache;
+
 		std::unique_ptr<VehicleEffect> m_pVehicleEffect;
 		std::unique_ptr<FireEffect> m_pFireEffect;
 
-		void InitializeVehicle();
-		void InitializeFire();
+		void InitializeVehicle(const MeshData& meshData);
+		void InitializeFire(const MeshData& meshData);
 	};
 }
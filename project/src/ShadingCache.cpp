@@ -0,0 +1,125 @@
+#include "ShadingCache.h"
+#include <algorithm>
+#include <utility>
+
+namespace dae
+{
+	namespace
+	{
+		bool IsSameLight(const Light& a, const Light& b)
+		{
+			return a.type == b.type
+				&& a.position.x == b.position.x && a.position.y == b.position.y && a.position.z == b.position.z
+				&& a.direction.x == b.direction.x && a.direction.y == b.direction.y && a.direction.z == b.direction.z
+				&& a.color.r == b.color.r && a.color.g == b.color.g && a.color.b == b.color.b
+				&& a.intensity == b.intensity && a.range == b.range
+				&& a.innerConeCos == b.innerConeCos && a.outerConeCos == b.outerConeCos;
+		}
+	}
+
+	ShadingCache::ShadingCache(int width, int height, int refreshPeriod, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+		: m_Width{ width }
+		, m_Height{ height }
+		, m_RefreshPeriod{ std::max(refreshPeriod, 1) }
+		, m_Surfaces(size_t(width) * height)
+		, m_IsCovered(size_t(width) * height, 0)
+		, m_Colors(size_t(width) * height)
+		, m_ShadedVersion(size_t(width) * height, 0)
+		, m_TexelFeedback(size_t(width) * height)
+	{
+		// Rasterize every triangle in uv space, same texel center convention as MaterialTexture::BakeObjectSpaceNormals
+		for (size_t index = 0; index + 2 < indices.size(); index += 3)
+		{
+			const Vertex& vertex0 = vertices[indices[index]];
+			const Vertex& vertex1 = vertices[indices[index + 1]];
+			const Vertex& vertex2 = vertices[indices[index + 2]];
+
+			const Vector2 p0{ vertex0.uv.x * m_Width, vertex0.uv.y * m_Height };
+			const Vector2 p1{ vertex1.uv.x * m_Width, vertex1.uv.y * m_Height };
+			const Vector2 p2{ vertex2.uv.x * m_Width, vertex2.uv.y * m_Height };
+
+			const float area = Vector2::Cross(p1 - p0, p2 - p0);
+			if (std::abs(area) < 1e-8f) continue;
+
+			const int minX = std::max(0, int(std::floor(std::min({ p0.x, p1.x, p2.x }))));
+			const int maxX = std::min(m_Width - 1, int(std::ceil(std::max({ p0.x, p1.x, p2.x }))));
+			const int minY = std::max(0, int(std::floor(std::min({ p0.y, p1.y, p2.y }))));
+			const int maxY = std::min(m_Height - 1, int(std::ceil(std::max({ p0.y, p1.y, p2.y }))));
+
+#pragma omp parallel for
+			for (int y = minY; y <= maxY; ++y)
+			{
+				for (int x = minX; x <= maxX; ++x)
+				{
+					const Vector2 p{ x + .5f, y + .5f };
+					const float weight0 = Vector2::Cross(p1 - p, p2 - p) / area;
+					const float weight1 = Vector2::Cross(p2 - p, p0 - p) / area;
+					const float weight2 = 1.f - weight0 - weight1;
+					if (weight0 < 0.f || weight1 < 0.f || weight2 < 0.f) continue;
+
+					const size_t texelIndex = size_t(y) * m_Width + x;
+					Surface& surface = m_Surfaces[texelIndex];
+					surface.uv = Vector2{ p.x / m_Width, p.y / m_Height };
+					surface.position = vertex0.position * weight0 + vertex1.position * weight1 + vertex2.position * weight2;
+					surface.normal = (vertex0.normal * weight0 + vertex1.normal * weight1 + vertex2.normal * weight2).Normalized();
+					m_IsCovered[texelIndex] = 1;
+				}
+			}
+		}
+
+		// Two rings of gutter: the bilinear fetch reaches one texel past an island edge, the second ring covers
+		// edge texels the uv raster missed because their centers fall just outside the triangles
+		constexpr int dilationPasses{ 2 };
+		for (int pass = 0; pass < dilationPasses; ++pass)
+		{
+			const std::vector<uint8_t> wasCovered = m_IsCovered;
+#pragma omp parallel for
+			for (int y = 0; y < m_Height; ++y)
+			{
+				for (int x = 0; x < m_Width; ++x)
+				{
+					const size_t texelIndex = size_t(y) * m_Width + x;
+					if (wasCovered[texelIndex]) continue;
+
+					for (const auto& [offsetX, offsetY] : { std::pair{ -1, 0 }, std::pair{ 1, 0 }, std::pair{ 0, -1 }, std::pair{ 0, 1 } })
+					{
+						const int neighborX = x + offsetX;
+						const int neighborY = y + offsetY;
+						if (neighborX < 0 || neighborX >= m_Width || neighborY < 0 || neighborY >= m_Height) continue;
+
+						const size_t neighborIndex = size_t(neighborY) * m_Width + neighborX;
+						if (!wasCovered[neighborIndex]) continue;
+
+						// The neighbor's surface, so the gutter extends the island's lighting instead of filtering in black
+						m_Surfaces[texelIndex] = m_Surfaces[neighborIndex];
+						m_IsCovered[texelIndex] = 1;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	int ShadingCache::GetWidth() const
+	{
+		return m_Width;
+	}
+
+	int ShadingCache::GetHeight() const
+	{
+		return m_Height;
+	}
+
+	void ShadingCache::UpdateLights(const Light* pLights, uint32_t lightCount)
+	{
+		bool isSame = m_Lights.size() == lightCount;
+		for (uint32_t i = 0; isSame && i < lightCount; ++i)
+		{
+			isSame = IsSameLight(m_Lights[i], pLights[i]);
+		}
+		if (isSame) return;
+
+		m_Lights.assign(pLights, pLights + lightCount);
+		++m_LightingVersion;
+	}
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "DataTypes.h"
+#include "TextureFilter.h"
+
+namespace dae
+{
+	// Lit color of a mesh in its own uv space. Texels sampled in one frame are shaded before the next,
+	// all of them while the lights move relative to the mesh, a 1 / refreshPeriod slice of them while they do not
+	class ShadingCache final
+	{
+	public:
+		// Object-space surface under one texel, from rasterizing the mesh in uv space
+		struct Surface
+		{
+			Vector2 uv{};
+			Vector3 position{};
+			Vector3 normal{};
+		};
+
+		ShadingCache(int width, int height, int refreshPeriod, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+		~ShadingCache() = default;
+
+		ShadingCache(const ShadingCache&) = delete;
+		ShadingCache(ShadingCache&&) noexcept = delete;
+		ShadingCache& operator=(const ShadingCache&) = delete;
+		ShadingCache& operator=(ShadingCache&&) noexcept = delete;
+
+		// Call once per frame before rasterizing, pLights are in the mesh's object space.
+		// ShadeTexel(const Surface&) returns the lit color of one texel
+		template<typename ShadeTexel>
+		void Update(const Light* pLights, uint32_t lightCount, const ShadeTexel& shadeTexel);
+
+		// Bilinear, the four texels read are shaded again for the next frame. A texel not shaded with the current
+		// lights, newly visible along a disocclusion or silhouette, is shaded directly through ShadeTexel instead
+		template<typename ShadeTexel>
+		ColorRGB Sample(const Vector2& uv, const ShadeTexel& shadeTexel) const;
+
+		int GetWidth() const;
+		int GetHeight() const;
+
+	private:
+		int m_Width{};
+		int m_Height{};
+		int m_RefreshPeriod{};
+
+		uint32_t m_Frame{};
+		uint32_t m_LightingVersion{ 1 };
+		std::vector<Light> m_Lights{};
+
+		std::vector<Surface> m_Surfaces{};
+		std::vector<uint8_t> m_IsCovered{};
+		std::vector<ColorRGB> m_Colors{};
+		std::vector<uint32_t> m_ShadedVersion{};					// lighting version the color was shaded with, 0 before the first shading
+		mutable std::vector<std::atomic<uint32_t>> m_TexelFeedback;	// frame the texel was last sampled
+
+		// Bumps the lighting version when the lights differ from the previous update
+		void UpdateLights(const Light* pLights, uint32_t lightCount);
+	};
+
+	template<typename ShadeTexel>
+	void ShadingCache::Update(const Light* pLights, uint32_t lightCount, const ShadeTexel& shadeTexel)
+	{
+		UpdateLights(pLights, lightCount);
+
+		// The feedback starts at 0, so the first update shades every covered texel
+		const uint32_t previousFrame = m_Frame++;
+
+#pragma omp parallel for
+		for (int y = 0; y < m_Height; ++y)
+		{
+			for (int x = 0; x < m_Width; ++x)
+			{
+				const size_t texelIndex = size_t(y) * m_Width + x;
+				if (!m_IsCovered[texelIndex]) continue;
+				if (m_TexelFeedback[texelIndex].load(std::memory_order_relaxed) != previousFrame) continue;
+
+				// Under static lights only the view-dependent specular drifts, one slice is refreshed per frame
+				const bool isStale = m_ShadedVersion[texelIndex] != m_LightingVersion;
+				if (!isStale && (texelIndex + m_Frame) % m_RefreshPeriod != 0) continue;
+
+				m_Colors[texelIndex] = shadeTexel(m_Surfaces[texelIndex]);
+				m_ShadedVersion[texelIndex] = m_LightingVersion;
+			}
+		}
+	}
+
+	template<typename ShadeTexel>
+	ColorRGB ShadingCache::Sample(const Vector2& uv, const ShadeTexel& shadeTexel) const
+	{
+		const uint32_t frame = m_Frame;
+		auto fetch = [this, frame, &shadeTexel](int x, int y, int)
+			{
+				const size_t texelIndex = size_t(y) * m_Width + x;
+
+				// Skip the store when another pixel already marked the texel, keeps the cache line shared
+				std::atomic<uint32_t>& feedback = m_TexelFeedback[texelIndex];
+				if (feedback.load(std::memory_order_relaxed) != frame) feedback.store(frame, std::memory_order_relaxed);
+
+				// The miss is marked above, so the next update caches it; until then it is never black or stale
+				if (m_IsCovered[texelIndex] && m_ShadedVersion[texelIndex] != m_LightingVersion) return shadeTexel(m_Surfaces[texelIndex]);
+				return m_Colors[texelIndex];
+			};
+
+		return TextureFilter::SampleBilinear<ColorRGB>(fetch, m_Width, m_Height, uv, 0);
+	}
+}
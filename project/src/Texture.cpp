@@ -1,25 +1,123 @@
 #include "Texture.h"
 
+#include <cassert>
+#include <atomic>
 #include <iostream>
 #include <ostream>
 
 #include "Vector2.h"
+#include "TextureFilter.h"
 #include <SDL_image.h>
 namespace dae
 {
+	namespace
+	{
+		// Small direct-mapped cache of decoded 4x4 blocks, one per sampling thread
+		struct DecodedBlock
+		{
+			uint32_t textureId{};
+			int blockIndex{ -1 };
+			uint8_t texels[BlockCompression::TexelsPerBlock * 4];
+		};
+
+		constexpr int decodedBlockCacheSize{ 64 };
+		thread_local DecodedBlock g_DecodedBlockCache[decodedBlockCacheSize];
+
+		std::atomic<uint32_t> g_NextTextureId{ 1 };
+
+		void DownsampleRGBA(const uint8_t* pTexel00, const uint8_t* pTexel10, const uint8_t* pTexel01, const uint8_t* pTexel11, uint8_t* pResult)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				pResult[c] = uint8_t((pTexel00[c] + pTexel10[c] + pTexel01[c] + pTexel11[c] + 2) / 4);
+			}
+		}
+
+		// Box-filtered RGBA8 chain down to 1x1, the base level itself is not included
+		std::vector<std::vector<uint8_t>> BuildMipChain(const uint8_t* pPixels, int width, int height, int pitch)
+		{
+			std::vector<std::vector<uint8_t>> mips{};
+
+			const uint8_t* pSource = pPixels;
+			int sourcePitch = pitch;
+			while (width > 1 || height > 1)
+			{
+				const int mipWidth = std::max(width / 2, 1);
+				const int mipHeight = std::max(height / 2, 1);
+				std::vector<uint8_t> mip(size_t(mipWidth) * mipHeight * 4);
+
+				for (int y = 0; y < mipHeight; ++y)
+				{
+					const uint8_t* pRow0 = pSource + size_t(std::min(y * 2, height - 1)) * sourcePitch;
+					const uint8_t* pRow1 = pSource + size_t(std::min(y * 2 + 1, height - 1)) * sourcePitch;
+					for (int x = 0; x < mipWidth; ++x)
+					{
+						const int x0 = std::min(x * 2, width - 1) * 4;
+						const int x1 = std::min(x * 2 + 1, width - 1) * 4;
+						DownsampleRGBA(pRow0 + x0, pRow0 + x1, pRow1 + x0, pRow1 + x1, mip.data() + (size_t(y) * mipWidth + x) * 4);
+					}
+				}
+
+				mips.push_back(std::move(mip));
+				pSource = mips.back().data();
+				sourcePitch = mipWidth * 4;
+				width = mipWidth;
+				height = mipHeight;
+			}
+
+			return mips;
+		}
+	}
+
+	TextureData::~TextureData()
+	{
+		if (pSurface)
+		{
+			SDL_FreeSurface(pSurface);
+			pSurface = nullptr;
+		}
+	}
+
+	Texture::Texture(ID3D11Device* pDevice, SDL_Surface* pSurface, TextureFormat format) :
+		Texture(pDevice, Decode(pSurface, format))
+	{
+	}
 
-	Texture::Texture(ID3D11Device* pDevice, SDL_Surface* pSurface)
+	Texture::Texture(ID3D11Device* pDevice, std::unique_ptr<TextureData> pData) :
+		m_Width(pData->width),
+		m_Height(pData->height),
+		m_Format(pData->format),
+		m_Id(g_NextTextureId++),
+		m_Mips(std::move(pData->mips))
 	{
-		m_pSurface = pSurface;
-		m_pSurfacePixels = (uint32_t*)pSurface->pixels;
+		D3D11_SUBRESOURCE_DATA initData;
+		if (m_Format == TextureFormat::R8G8B8A8)
+		{
+			m_pSurface = pData->pSurface;
+			m_pSurfacePixels = (uint32_t*)m_pSurface->pixels;
+			pData->pSurface = nullptr;
+
+			initData.pSysMem = m_pSurface->pixels;
+			initData.SysMemPitch = static_cast<UINT>(m_pSurface->pitch);
+			initData.SysMemSlicePitch = static_cast<UINT>(m_pSurface->h * m_pSurface->pitch);
+		}
+		else
+		{
+			m_Blocks = std::move(pData->blocks);
+			m_BlocksWide = m_Width / BlockCompression::BlockDimension;
+
+			initData.pSysMem = m_Blocks.data();
+			initData.SysMemPitch = static_cast<UINT>(m_BlocksWide * BlockCompression::GetBlockSize(m_Format));
+			initData.SysMemSlicePitch = static_cast<UINT>(m_Blocks.size());
+		}
 
-		DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		DXGI_FORMAT dxgiFormat = BlockCompression::GetDXGIFormat(m_Format);
 		D3D11_TEXTURE2D_DESC desc{};
-		desc.Width = pSurface->w;
-		desc.Height = pSurface->h;
+		desc.Width = m_Width;
+		desc.Height = m_Height;
 		desc.MipLevels = 1;
 		desc.ArraySize = 1;
-		desc.Format = format;
+		desc.Format = dxgiFormat;
 		desc.SampleDesc.Count = 1;
 		desc.SampleDesc.Quality = 0;
 		desc.Usage = D3D11_USAGE_DEFAULT;
@@ -27,19 +125,16 @@ namespace dae
 		desc.CPUAccessFlags = 0;
 		desc.MiscFlags = 0;
 
-		D3D11_SUBRESOURCE_DATA initData;
-		initData.pSysMem = pSurface->pixels;
-		initData.SysMemPitch = static_cast<UINT>(pSurface->pitch);
-		initData.SysMemSlicePitch = static_cast<UINT>(pSurface->h * pSurface->pitch);
-
 		HRESULT hr = pDevice->CreateTexture2D(&desc, &initData, &m_pResource);
 
 		D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc{};
-		SRVDesc.Format = format;
+		SRVDesc.Format = dxgiFormat;
 		SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
 		SRVDesc.Texture2D.MipLevels = 1;
 
 		if (m_pResource != 0) hr = pDevice->CreateShaderResourceView(m_pResource, &SRVDesc, &m_pShaderResourceView);
+
+		BuildAlphaHierarchy();
 	}
 
 	Texture::~Texture()
@@ -63,10 +158,56 @@ namespace dae
 		}
 	}
 
-	std::unique_ptr<Texture> Texture::LoadFromFile(ID3D11Device* pDevice, const std::string& textureFile)
+	std::unique_ptr<Texture> Texture::LoadFromFile(ID3D11Device* pDevice, const std::string& textureFile, TextureFormat format)
+	{
+
+		return std::make_unique<Texture>(pDevice, Decode(textureFile, format));
+	}
+
+	std::unique_ptr<TextureData> Texture::Decode(const std::string& textureFile, TextureFormat format)
+	{
+		SDL_Surface* pSurface = IMG_Load(textureFile.c_str());
+		if (!pSurface)
+		{
+			std::cout << "Texture: Failed to load!\nPath: " << textureFile << "\n" << IMG_GetError() << '\n';
+			return nullptr;
+		}
+
+		return Decode(pSurface, format);
+	}
+
+	std::unique_ptr<TextureData> Texture::Decode(SDL_Surface* pSurface, TextureFormat format)
 	{
+		if (!pSurface) return nullptr;
+
+		auto pData = std::make_unique<TextureData>();
+		pData->width = pSurface->w;
+		pData->height = pSurface->h;
+		pData->format = format;
+
+		// Block formats need whole 4x4 blocks
+		if (pData->width % BlockCompression::BlockDimension != 0 || pData->height % BlockCompression::BlockDimension != 0)
+		{
+			pData->format = TextureFormat::R8G8B8A8;
+		}
+
+		SDL_Surface* pRGBASurface = SDL_ConvertSurfaceFormat(pSurface, SDL_PIXELFORMAT_RGBA32, 0);
+		const uint8_t* pRGBAPixels = static_cast<const uint8_t*>(pRGBASurface->pixels);
+		pData->mips = BuildMipChain(pRGBAPixels, pData->width, pData->height, pRGBASurface->pitch);
 
-		return std::make_unique<Texture>(pDevice, IMG_Load(textureFile.c_str()));
+		// The texture keeps the converted copy, its rows are what the GPU and the page file expect
+		if (pData->format == TextureFormat::R8G8B8A8)
+		{
+			SDL_FreeSurface(pSurface);
+			pData->pSurface = pRGBASurface;
+			return pData;
+		}
+
+		pData->blocks = BlockCompression::EncodeImage(pData->format, pRGBAPixels, pData->width, pData->height, pRGBASurface->pitch);
+		SDL_FreeSurface(pRGBASurface);
+		SDL_FreeSurface(pSurface);
+
+		return pData;
 	}
 
 	ID3D11ShaderResourceView* Texture::GetShaderResourceView() const
@@ -79,41 +220,325 @@ namespace dae
 		float u = uv.x;
 		float v = uv.y;
 
-		int x = static_cast<int>(u * m_pSurface->w);
-		int y = static_cast<int>(v * m_pSurface->h);
+		int x = static_cast<int>(u * m_Width);
+		int y = static_cast<int>(v * m_Height);
+
+		SDL_Color texel = FetchTexel(x, y);
+
+		return { float(texel.r) / 255.f, float(texel.g) / 255.f, float(texel.b) / 255.f };
+	}
 
-		x = std::clamp(x, 0, m_pSurface->w - 1);
-		y = std::clamp(y, 0, m_pSurface->h - 1);
+	ColorRGBA Texture::SampleWithAlpha(const Vector2& uv) const
+	{
+		float u = uv.x;
+		float v = uv.y;
 
-		int pixelIndex = y * m_pSurface->w + x;
+		int x = static_cast<int>(u * m_Width);
+		int y = static_cast<int>(v * m_Height);
 
-		uint32_t pixel = m_pSurfacePixels[pixelIndex];
+		SDL_Color texel = FetchTexel(x, y);
 
-		Uint8 r, g, b;
-		SDL_GetRGB(pixel, m_pSurface->format, &r, &g, &b);
+		return{ float(texel.r) / 255.f, float(texel.g) / 255.f, float(texel.b) / 255.f, float(texel.a) / 255.f };
+	}
 
+	ColorRGBA Texture::Sample(const Vector2& uv, const Vector2& uvDdx, const Vector2& uvDdy, FilteringTechnique filter) const
+	{
+		auto fetch = [this](int x, int y, int mip)
+			{
+				const SDL_Color texel = FetchTexel(x, y, mip);
+				return ColorRGBA{ float(texel.r) / 255.f, float(texel.g) / 255.f, float(texel.b) / 255.f, float(texel.a) / 255.f };
+			};
 
-		return { float(r) / 255.f, float(g) / 255.f, float(b) / 255.f };
+		return TextureFilter::Sample<ColorRGBA>(fetch, m_Width, m_Height, GetMipCount(), uv, uvDdx, uvDdy, filter);
 	}
 
-	ColorRGBA Texture::SampleWithAlpha(const Vector2& uv) const
+	bool Texture::IsTransparent(const Vector2& uv, const Vector2& uvDdx, const Vector2& uvDdy, FilteringTechnique filter) const
 	{
-		float u = uv.x;
-		float v = uv.y;
+		assert(!m_MaxAlphaLevels.empty() && "The CPU copy of this texture was released");
 
-		int x = static_cast<int>(u * m_pSurface->w);
-		int y = static_cast<int>(v * m_pSurface->h);
+		// Probe centers stay inside the pixel's parallelogram; the filters then reach at most two texels
+		// of mip floor(lod) + 1 further out, which is the margin in base texels
+		const TextureFilter::Footprint footprint = TextureFilter::ComputeFootprint(uvDdx, uvDdy, m_Width, m_Height, filter);
+		const int mip = int(std::clamp(footprint.lod, 0.f, float(GetMipCount() - 1)));
+		const float margin = float(4 << mip);
 
-		x = std::clamp(x, 0, m_pSurface->w - 1);
-		y = std::clamp(y, 0, m_pSurface->h - 1);
+		const float extentX = .5f * (std::abs(uvDdx.x) + std::abs(uvDdy.x)) * m_Width + margin;
+		const float extentY = .5f * (std::abs(uvDdx.y) + std::abs(uvDdy.y)) * m_Height + margin;
+		if (extentX * 2.f >= float(m_Width) || extentY * 2.f >= float(m_Height)) return m_MaxAlphaLevels.back().front() == 0;
 
-		int pixelIndex = y * m_pSurface->w + x;
+		const int minX = int(std::floor(uv.x * m_Width - extentX));
+		const int maxX = int(std::floor(uv.x * m_Width + extentX));
+		const int minY = int(std::floor(uv.y * m_Height - extentY));
+		const int maxY = int(std::floor(uv.y * m_Height + extentY));
 
-		uint32_t pixel = m_pSurfacePixels[pixelIndex];
+		// The rectangle is narrower than the texture, so with wrapping it splits into at most two spans per axis
+		auto getSpans = [](int first, int last, int size, std::pair<int, int>* pSpans)
+			{
+				const int wrappedFirst = TextureFilter::Wrap(first, size);
+				const int wrappedLast = wrappedFirst + (last - first);
+				if (wrappedLast < size)
+				{
+					pSpans[0] = { wrappedFirst, wrappedLast };
+					return 1;
+				}
+				pSpans[0] = { wrappedFirst, size - 1 };
+				pSpans[1] = { 0, wrappedLast - size };
+				return 2;
+			};
 
-		Uint8 r, g, b, a;
-		SDL_GetRGBA(pixel, m_pSurface->format, &r, &g, &b, &a);
+		std::pair<int, int> spansX[2];
+		std::pair<int, int> spansY[2];
+		const int spanCountX = getSpans(minX, maxX, m_Width, spansX);
+		const int spanCountY = getSpans(minY, maxY, m_Height, spansY);
+		for (int y = 0; y < spanCountY; ++y)
+		{
+			for (int x = 0; x < spanCountX; ++x)
+			{
+				if (GetMaxAlpha(spansX[x].first, spansY[y].first, spansX[x].second, spansY[y].second) > 0) return false;
+			}
+		}
+		return true;
+	}
 
-		return{ float(r) / 255.f, float(g) / 255.f, float(b) / 255.f, float(a) / 255.f };
+	int Texture::GetWidth() const
+	{
+		return m_Width;
+	}
+
+	int Texture::GetHeight() const
+	{
+		return m_Height;
+	}
+
+	TextureFormat Texture::GetFormat() const
+	{
+		return m_Format;
+	}
+
+	int Texture::GetMipCount() const
+	{
+		if (m_pUVirtualTexture) return m_pUVirtualTexture->GetMipCount();
+		return int(m_Mips.size()) + 1;
+	}
+
+	SDL_Color Texture::FetchTexel(int x, int y, int mip) const
+	{
+		assert(HasCPUCopy() && "The CPU copy of this texture was released");
+
+		SDL_Color texel;
+		if (m_pUVirtualTexture)
+		{
+			// Level 0 is paged in its stored format, blocks go through the same decode cache as the resident copy
+			const VirtualTexture::TexelLocation location = m_pUVirtualTexture->Locate(x, y, mip);
+			const uint8_t* pTexel = location.pElement;
+			if (location.mip == 0 && m_Format != TextureFormat::R8G8B8A8)
+			{
+				const int blockIndex = (location.y / BlockCompression::BlockDimension) * m_BlocksWide + location.x / BlockCompression::BlockDimension;
+				pTexel = GetDecodedBlock(blockIndex, location.pElement) + ((location.y % BlockCompression::BlockDimension) * BlockCompression::BlockDimension + location.x % BlockCompression::BlockDimension) * 4;
+			}
+			texel = { pTexel[0], pTexel[1], pTexel[2], pTexel[3] };
+			return texel;
+		}
+
+		mip = std::clamp(mip, 0, int(m_Mips.size()));
+		if (mip > 0)
+		{
+			const int mipWidth = TextureFilter::GetMipSize(m_Width, mip);
+			const int mipHeight = TextureFilter::GetMipSize(m_Height, mip);
+			x = std::clamp(x, 0, mipWidth - 1);
+			y = std::clamp(y, 0, mipHeight - 1);
+
+			const uint8_t* pTexel = m_Mips[mip - 1].data() + (size_t(y) * mipWidth + x) * 4;
+			texel = { pTexel[0], pTexel[1], pTexel[2], pTexel[3] };
+			return texel;
+		}
+
+		x = std::clamp(x, 0, m_Width - 1);
+		y = std::clamp(y, 0, m_Height - 1);
+
+		if (m_Format == TextureFormat::R8G8B8A8)
+		{
+			uint32_t pixel = m_pSurfacePixels[y * m_Width + x];
+			SDL_GetRGBA(pixel, m_pSurface->format, &texel.r, &texel.g, &texel.b, &texel.a);
+			return texel;
+		}
+
+		const int blockIndex = (y / BlockCompression::BlockDimension) * m_BlocksWide + x / BlockCompression::BlockDimension;
+		const uint8_t* pBlock = m_Blocks.data() + blockIndex * BlockCompression::GetBlockSize(m_Format);
+		const uint8_t* pTexel = GetDecodedBlock(blockIndex, pBlock) + ((y % BlockCompression::BlockDimension) * BlockCompression::BlockDimension + x % BlockCompression::BlockDimension) * 4;
+
+		texel = { pTexel[0], pTexel[1], pTexel[2], pTexel[3] };
+		return texel;
+	}
+
+	void Texture::Virtualize(PageCache* pCache)
+	{
+		if (m_pUVirtualTexture) return;
+
+		// Level 0 keeps its stored format, so block-compressed textures page their blocks; the mips are RGBA8
+		std::vector<VirtualTexture::LevelFormat> levels{};
+		if (m_Format == TextureFormat::R8G8B8A8) levels.push_back({ m_Width, m_Height, 1, 4 });
+		else levels.push_back({ m_Width, m_Height, BlockCompression::BlockDimension, int(BlockCompression::GetBlockSize(m_Format)) });
+		for (int mip = 1; mip < GetMipCount(); ++mip)
+		{
+			levels.push_back({ TextureFilter::GetMipSize(m_Width, mip), TextureFilter::GetMipSize(m_Height, mip), 1, 4 });
+		}
+
+		// Each level is paged straight from the resident copy and dropped once the next one is asked for
+		m_pUVirtualTexture = std::make_unique<VirtualTexture>(pCache, levels, [this](int mip, size_t& pitch) -> const uint8_t*
+			{
+				if (mip == 0)
+				{
+					if (m_Format == TextureFormat::R8G8B8A8)
+					{
+						pitch = size_t(m_pSurface->pitch);
+						return static_cast<const uint8_t*>(m_pSurface->pixels);
+					}
+					pitch = size_t(m_BlocksWide) * BlockCompression::GetBlockSize(m_Format);
+					return m_Blocks.data();
+				}
+
+				if (mip == 1)
+				{
+					if (m_pSurface)
+					{
+						SDL_FreeSurface(m_pSurface);
+						m_pSurface = nullptr;
+						m_pSurfacePixels = nullptr;
+					}
+					std::vector<uint8_t>().swap(m_Blocks);
+				}
+				else std::vector<uint8_t>().swap(m_Mips[mip - 2]);
+
+				pitch = size_t(TextureFilter::GetMipSize(m_Width, mip)) * 4;
+				return m_Mips[mip - 1].data();
+			});
+
+		// The pages now live on disk, drop what is left of the resident copies
+		FreeResidentCopy();
+	}
+
+	bool Texture::IsVirtual() const
+	{
+		return m_pUVirtualTexture != nullptr;
+	}
+
+	void Texture::ReleaseCPUCopy()
+	{
+		FreeResidentCopy();
+		m_pUVirtualTexture.reset();
+		std::vector<std::vector<uint8_t>>().swap(m_MaxAlphaLevels);
+		std::vector<std::pair<int, int>>().swap(m_MaxAlphaLevelSizes);
+	}
+
+	bool Texture::HasCPUCopy() const
+	{
+		return m_pSurface != nullptr || !m_Blocks.empty() || m_pUVirtualTexture != nullptr;
+	}
+
+	void Texture::FreeResidentCopy()
+	{
+		if (m_pSurface)
+		{
+			SDL_FreeSurface(m_pSurface);
+			m_pSurface = nullptr;
+			m_pSurfacePixels = nullptr;
+		}
+		std::vector<uint8_t>().swap(m_Blocks);
+		std::vector<std::vector<uint8_t>>().swap(m_Mips);
+	}
+
+	void Texture::BuildAlphaHierarchy()
+	{
+		int blocksWide = (m_Width + AlphaBlockSize - 1) / AlphaBlockSize;
+		int blocksHigh = (m_Height + AlphaBlockSize - 1) / AlphaBlockSize;
+
+		std::vector<uint8_t> blocks(size_t(blocksWide) * blocksHigh, 0);
+#pragma omp parallel for
+		for (int blockY = 0; blockY < blocksHigh; ++blockY)
+		{
+			for (int blockX = 0; blockX < blocksWide; ++blockX)
+			{
+				uint8_t& maxAlpha = blocks[size_t(blockY) * blocksWide + blockX];
+				for (int y = blockY * AlphaBlockSize; y < std::min((blockY + 1) * AlphaBlockSize, m_Height); ++y)
+				{
+					for (int x = blockX * AlphaBlockSize; x < std::min((blockX + 1) * AlphaBlockSize, m_Width); ++x)
+					{
+						maxAlpha = std::max(maxAlpha, FetchTexel(x, y).a);
+					}
+				}
+			}
+		}
+		m_MaxAlphaLevels.push_back(std::move(blocks));
+		m_MaxAlphaLevelSizes.push_back({ blocksWide, blocksHigh });
+
+		while (blocksWide > 1 || blocksHigh > 1)
+		{
+			const int belowWide = blocksWide;
+			const int belowHigh = blocksHigh;
+			blocksWide = (blocksWide + 1) / 2;
+			blocksHigh = (blocksHigh + 1) / 2;
+
+			std::vector<uint8_t> level(size_t(blocksWide) * blocksHigh, 0);
+			const std::vector<uint8_t>& below = m_MaxAlphaLevels.back();
+			for (int blockY = 0; blockY < blocksHigh; ++blockY)
+			{
+				for (int blockX = 0; blockX < blocksWide; ++blockX)
+				{
+					uint8_t& maxAlpha = level[size_t(blockY) * blocksWide + blockX];
+					for (int y = blockY * 2; y < std::min(blockY * 2 + 2, belowHigh); ++y)
+					{
+						for (int x = blockX * 2; x < std::min(blockX * 2 + 2, belowWide); ++x)
+						{
+							maxAlpha = std::max(maxAlpha, below[size_t(y) * belowWide + x]);
+						}
+					}
+				}
+			}
+			m_MaxAlphaLevels.push_back(std::move(level));
+			m_MaxAlphaLevelSizes.push_back({ blocksWide, blocksHigh });
+		}
+	}
+
+	uint8_t Texture::GetMaxAlpha(int minX, int minY, int maxX, int maxY) const
+	{
+		// Climb until the rectangle spans at most 2x2 blocks, a block of level n covers 2^n base blocks per axis
+		int level = 0;
+		int blockMinX = minX / AlphaBlockSize;
+		int blockMinY = minY / AlphaBlockSize;
+		int blockMaxX = maxX / AlphaBlockSize;
+		int blockMaxY = maxY / AlphaBlockSize;
+		while ((blockMaxX - blockMinX > 1 || blockMaxY - blockMinY > 1) && level + 1 < int(m_MaxAlphaLevels.size()))
+		{
+			blockMinX /= 2;
+			blockMinY /= 2;
+			blockMaxX /= 2;
+			blockMaxY /= 2;
+			++level;
+		}
+
+		const std::vector<uint8_t>& blocks = m_MaxAlphaLevels[level];
+		const int blocksWide = m_MaxAlphaLevelSizes[level].first;
+		uint8_t maxAlpha = 0;
+		for (int blockY = blockMinY; blockY <= blockMaxY; ++blockY)
+		{
+			for (int blockX = blockMinX; blockX <= blockMaxX; ++blockX)
+			{
+				maxAlpha = std::max(maxAlpha, blocks[size_t(blockY) * blocksWide + blockX]);
+			}
+		}
+		return maxAlpha;
+	}
+
+	const uint8_t* Texture::GetDecodedBlock(int blockIndex, const uint8_t* pBlock) const
+	{
+		DecodedBlock& entry = g_DecodedBlockCache[(uint32_t(blockIndex) ^ (m_Id * 0x9E3779B1u)) % decodedBlockCacheSize];
+		if (entry.textureId != m_Id || entry.blockIndex != blockIndex)
+		{
+			BlockCompression::DecodeBlock(m_Format, pBlock, entry.texels);
+			entry.textureId = m_Id;
+			entry.blockIndex = blockIndex;
+		}
+		return entry.texels;
 	}
 }
@@ -3,26 +3,100 @@
 #include <memory.h>
 #include "Vector2.h"
 #include "ColorRGBA.h"
+#include "BlockCompression.h"
+#include "VirtualTexture.h"
+#include "DataTypes.h"
 namespace dae
 {
+	// Decoded CPU-side image, produced without touching the device so it can be built on any thread
+	struct TextureData final
+	{
+		TextureData() = default;
+		~TextureData();
+
+		TextureData(const TextureData&) = delete;
+		TextureData(TextureData&&) noexcept = delete;
+		TextureData& operator=(const TextureData&) = delete;
+		TextureData& operator=(TextureData&&) noexcept = delete;
+
+		SDL_Surface* pSurface{ nullptr };	// only for R8G8B8A8, in SDL_PIXELFORMAT_RGBA32; ownership moves to the Texture
+		std::vector<uint8_t> blocks{};		// only for block-compressed formats
+		std::vector<std::vector<uint8_t>> mips{};	// RGBA8 levels 1 and up, for the CPU sampler
+		int width{};
+		int height{};
+		TextureFormat format{ TextureFormat::R8G8B8A8 };
+	};
+
 	class Texture
 	{
 	public:
-		Texture(ID3D11Device* pDevice, SDL_Surface* pSurface);
+		Texture(ID3D11Device* pDevice, SDL_Surface* pSurface, TextureFormat format = TextureFormat::R8G8B8A8);
+		Texture(ID3D11Device* pDevice, std::unique_ptr<TextureData> pData);
 		~Texture();
 
-		static std::unique_ptr<Texture> LoadFromFile(ID3D11Device* pDevice, const std::string& textureFile);
+		static std::unique_ptr<Texture> LoadFromFile(ID3D11Device* pDevice, const std::string& textureFile, TextureFormat format = TextureFormat::R8G8B8A8);
+
+		// CPU half of loading (decode + compression), safe to run on a worker thread.
+		// Returns nullptr when the image cannot be loaded, the file version reports why
+		static std::unique_ptr<TextureData> Decode(const std::string& textureFile, TextureFormat format = TextureFormat::R8G8B8A8);
+		static std::unique_ptr<TextureData> Decode(SDL_Surface* pSurface, TextureFormat format = TextureFormat::R8G8B8A8);
 
 		ID3D11ShaderResourceView* GetShaderResourceView() const;
 		ColorRGB Sample(const Vector2& uv) const;
 
 		ColorRGBA SampleWithAlpha(const Vector2& uv) const;
 
+		// Filtered sample matching the D3D11 samplers, the uv derivatives are per screen pixel
+		ColorRGBA Sample(const Vector2& uv, const Vector2& uvDdx, const Vector2& uvDdy, FilteringTechnique filter) const;
+
+		// True when every texel the filtered Sample above can read has alpha 0, from the alpha min/max hierarchy
+		bool IsTransparent(const Vector2& uv, const Vector2& uvDdx, const Vector2& uvDdy, FilteringTechnique filter) const;
+
+		int GetWidth() const;
+		int GetHeight() const;
+		TextureFormat GetFormat() const;
+		int GetMipCount() const;
+		SDL_Color FetchTexel(int x, int y, int mip = 0) const;
+
+		// Moves the CPU copy into pages managed by the cache one level at a time, the GPU resource is unaffected
+		void Virtualize(PageCache* pCache);
+		bool IsVirtual() const;
+
+		// Drops every CPU copy once nothing samples the texture on the CPU, only the GPU resource stays
+		void ReleaseCPUCopy();
+		bool HasCPUCopy() const;
+
 	private:
-		SDL_Surface* m_pSurface;
+		SDL_Surface* m_pSurface{ nullptr };
 		uint32_t* m_pSurfacePixels{ nullptr };
 
+		int m_Width{};
+		int m_Height{};
+
+		// Block-compressed copy for the CPU sampler, replaces the surface when the format is not R8G8B8A8
+		TextureFormat m_Format{ TextureFormat::R8G8B8A8 };
+		std::vector<uint8_t> m_Blocks{};
+		int m_BlocksWide{};
+		uint32_t m_Id{};
+		std::vector<std::vector<uint8_t>> m_Mips{};
+
+		// Largest alpha per 8x8 texel block, then per 2x2 blocks of the level below up to a single block.
+		// Built at load and kept when the texture is virtualized
+		static constexpr int AlphaBlockSize{ 8 };
+		std::vector<std::vector<uint8_t>> m_MaxAlphaLevels{};
+		std::vector<std::pair<int, int>> m_MaxAlphaLevelSizes{};	// blocks wide and high per level
+
+		// Replaces both CPU copies above once the texture is virtualized, block-compressed level 0 stays compressed
+		std::unique_ptr<VirtualTexture> m_pUVirtualTexture{};
+
 		ID3D11Texture2D* m_pResource = nullptr;
 		ID3D11ShaderResourceView* m_pShaderResourceView = nullptr;
+
+		// pBlock is only read on a cache miss
+		const uint8_t* GetDecodedBlock(int blockIndex, const uint8_t* pBlock) const;
+		void BuildAlphaHierarchy();
+		// Inclusive texel rectangle inside the base level
+		uint8_t GetMaxAlpha(int minX, int minY, int maxX, int maxY) const;
+		void FreeResidentCopy();
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include "DataTypes.h"
+#include <algorithm>
+#include <cmath>
+
+namespace dae
+{
+	// CPU counterparts of the D3D11 point, linear and anisotropic samplers (wrap addressing)
+	namespace TextureFilter
+	{
+		constexpr int MaxAnisotropy{ 16 };
+
+		// Pixel footprint in texel space, built from the screen-space uv derivatives
+		struct Footprint
+		{
+			float lod{};
+			int probeCount{ 1 };
+			Vector2 probeStep{};	// uv distance between two probes along the major axis
+		};
+
+		inline Footprint ComputeFootprint(const Vector2& uvDdx, const Vector2& uvDdy, int width, int height, FilteringTechnique filter)
+		{
+			const Vector2 ddx{ uvDdx.x * width, uvDdx.y * height };
+			const Vector2 ddy{ uvDdy.x * width, uvDdy.y * height };
+			const float lengthX = ddx.Magnitude();
+			const float lengthY = ddy.Magnitude();
+			const float major = std::max(lengthX, lengthY);
+			const float minor = std::min(lengthX, lengthY);
+
+			Footprint footprint{};
+			if (filter != FilteringTechnique::Anisotropic || minor <= 0.f)
+			{
+				footprint.lod = std::log2(std::max(major, 1e-6f));
+				return footprint;
+			}
+
+			// Enough probes to cover the major axis with footprints the size of the minor one, the mip follows the probe size
+			footprint.probeCount = std::clamp(int(std::ceil(major / minor)), 1, MaxAnisotropy);
+			footprint.lod = std::log2(std::max(major / footprint.probeCount, 1e-6f));
+			footprint.probeStep = (lengthX > lengthY ? uvDdx : uvDdy) / float(footprint.probeCount);
+			return footprint;
+		}
+
+		inline int Wrap(int coordinate, int size)
+		{
+			coordinate %= size;
+			return coordinate < 0 ? coordinate + size : coordinate;
+		}
+
+		inline int GetMipSize(int size, int mip)
+		{
+			return std::max(size >> mip, 1);
+		}
+
+		// Fetch(x, y, mip) returns a Texel supporting "*= float" and "+= Texel", coordinates are already wrapped
+		template<typename Texel, typename Fetch>
+		Texel SampleNearest(const Fetch& fetch, int width, int height, const Vector2& uv, int mip)
+		{
+			const int mipWidth = GetMipSize(width, mip);
+			const int mipHeight = GetMipSize(height, mip);
+			return fetch(Wrap(int(std::floor(uv.x * mipWidth)), mipWidth), Wrap(int(std::floor(uv.y * mipHeight)), mipHeight), mip);
+		}
+
+		template<typename Texel, typename Fetch>
+		Texel SampleBilinear(const Fetch& fetch, int width, int height, const Vector2& uv, int mip)
+		{
+			const int mipWidth = GetMipSize(width, mip);
+			const int mipHeight = GetMipSize(height, mip);
+
+			const float x = uv.x * mipWidth - .5f;
+			const float y = uv.y * mipHeight - .5f;
+			const float floorX = std::floor(x);
+			const float floorY = std::floor(y);
+			const float fractionX = x - floorX;
+			const float fractionY = y - floorY;
+
+			const int x0 = Wrap(int(floorX), mipWidth);
+			const int y0 = Wrap(int(floorY), mipHeight);
+			const int x1 = Wrap(x0 + 1, mipWidth);
+			const int y1 = Wrap(y0 + 1, mipHeight);
+
+			Texel result = fetch(x0, y0, mip);
+			result *= (1.f - fractionX) * (1.f - fractionY);
+
+			Texel texel = fetch(x1, y0, mip);
+			texel *= fractionX * (1.f - fractionY);
+			result += texel;
+
+			texel = fetch(x0, y1, mip);
+			texel *= (1.f - fractionX) * fractionY;
+			result += texel;
+
+			texel = fetch(x1, y1, mip);
+			texel *= fractionX * fractionY;
+			result += texel;
+
+			return result;
+		}
+
+		template<typename Texel, typename Fetch>
+		Texel SampleTrilinear(const Fetch& fetch, int width, int height, int mipCount, const Vector2& uv, float lod)
+		{
+			const int mip0 = int(lod);
+			const int mip1 = std::min(mip0 + 1, mipCount - 1);
+			const float fraction = lod - float(mip0);
+
+			Texel result = SampleBilinear<Texel>(fetch, width, height, uv, mip0);
+			if (mip1 == mip0 || fraction <= 0.f) return result;
+
+			Texel coarser = SampleBilinear<Texel>(fetch, width, height, uv, mip1);
+			result *= 1.f - fraction;
+			coarser *= fraction;
+			result += coarser;
+			return result;
+		}
+
+		// Footprint computed by the caller, for shaders that also pick a shading tier from it
+		template<typename Texel, typename Fetch>
+		Texel Sample(const Fetch& fetch, int width, int height, int mipCount, const Vector2& uv, const Footprint& footprint, FilteringTechnique filter)
+		{
+			const float lod = std::clamp(footprint.lod, 0.f, float(mipCount - 1));
+
+			if (filter == FilteringTechnique::Point)
+			{
+				return SampleNearest<Texel>(fetch, width, height, uv, int(lod + .5f));
+			}
+
+			// Isotropic footprints stay on the cheap trilinear path
+			if (footprint.probeCount == 1)
+			{
+				return SampleTrilinear<Texel>(fetch, width, height, mipCount, uv, lod);
+			}
+
+			const float firstOffset = -.5f * float(footprint.probeCount - 1);
+			Texel result = SampleTrilinear<Texel>(fetch, width, height, mipCount, uv + footprint.probeStep * firstOffset, lod);
+			for (int probe = 1; probe < footprint.probeCount; ++probe)
+			{
+				result += SampleTrilinear<Texel>(fetch, width, height, mipCount, uv + footprint.probeStep * (firstOffset + float(probe)), lod);
+			}
+			result *= 1.f / float(footprint.probeCount);
+			return result;
+		}
+
+		template<typename Texel, typename Fetch>
+		Texel Sample(const Fetch& fetch, int width, int height, int mipCount, const Vector2& uv, const Vector2& uvDdx, const Vector2& uvDdy, FilteringTechnique filter)
+		{
+			return Sample<Texel>(fetch, width, height, mipCount, uv, ComputeFootprint(uvDdx, uvDdy, width, height, filter), filter);
+		}
+	}
+}
@@ -0,0 +1,48 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace dae
+{
+	ThreadPool::ThreadPool(unsigned int numThreads)
+	{
+		numThreads = std::max(numThreads, 1u);
+		m_Workers.reserve(numThreads);
+		for (unsigned int i = 0; i < numThreads; ++i)
+		{
+			m_Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			m_IsStopping = true;
+		}
+		m_Condition.notify_all();
+
+		for (std::thread& worker : m_Workers)
+		{
+			worker.join();
+		}
+	}
+
+	void ThreadPool::WorkerLoop()
+	{
+		while (true)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock{ m_Mutex };
+				m_Condition.wait(lock, [this]() { return m_IsStopping || !m_Tasks.empty(); });
+
+				// Drain the queue before stopping so no future is left unresolved
+				if (m_Tasks.empty()) return;
+
+				task = std::move(m_Tasks.front());
+				m_Tasks.pop();
+			}
+			task();
+		}
+	}
+}
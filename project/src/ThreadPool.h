@@ -0,0 +1,50 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace dae
+{
+	class ThreadPool final
+	{
+	public:
+		explicit ThreadPool(unsigned int numThreads = std::thread::hardware_concurrency());
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		// Queues a job and returns a future that resolves once a worker has run it
+		template<typename Function>
+		auto Submit(Function&& function) -> std::future<std::invoke_result_t<Function>>
+		{
+			using Result = std::invoke_result_t<Function>;
+
+			auto pTask = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+			std::future<Result> future = pTask->get_future();
+			{
+				std::lock_guard<std::mutex> lock{ m_Mutex };
+				m_Tasks.emplace([pTask]() { (*pTask)(); });
+			}
+			m_Condition.notify_one();
+
+			return future;
+		}
+
+	private:
+		std::vector<std::thread> m_Workers{};
+		std::queue<std::function<void()>> m_Tasks{};
+		std::mutex m_Mutex{};
+		std::condition_variable m_Condition{};
+		bool m_IsStopping{ false };
+
+		void WorkerLoop();
+	};
+}
@@ -0,0 +1,428 @@
+#include "pch.h"
+#include "TransparencyBuffer.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace dae
+{
+	namespace
+	{
+		// The depth weight of McGuire and Bavoil's equation 7, divided by its 3e3 maximum
+		float GetDepthWeight(float viewDepth)
+		{
+			const float farTerm = viewDepth / 200.f;
+			const float weight = 10.f / (1e-5f + Square(viewDepth / 5.f) + Square(farTerm * farTerm * farTerm));
+			return std::clamp(weight, 1e-2f, 3e3f) / 3e3f;
+		}
+
+		// (source * alpha + destination * (255 - alpha)) / 255 rounded, all in 0-255.
+		// With t = x + 128, (t + (t >> 8)) >> 8 is the exact rounded division by 255 for any x up to 255 * 255
+		inline uint32_t BlendChannel8(uint32_t source, uint32_t destination, uint32_t alpha)
+		{
+			const uint32_t t = source * alpha + destination * (255 - alpha) + 128;
+			return (t + (t >> 8)) >> 8;
+		}
+
+		// BlendChannel8 on every byte of a packed pixel, two bytes at a time in the 16-bit halves of a word
+		inline uint32_t BlendPacked(uint32_t destination, uint32_t source, uint32_t alpha)
+		{
+			auto blendHalves = [alpha](uint32_t source16, uint32_t destination16)
+				{
+					const uint32_t t = source16 * alpha + destination16 * (255 - alpha) + 0x00800080u;
+					return ((t + ((t >> 8) & 0x00FF00FFu)) >> 8) & 0x00FF00FFu;
+				};
+
+			return blendHalves(source & 0x00FF00FFu, destination & 0x00FF00FFu) |
+				blendHalves((source >> 8) & 0x00FF00FFu, (destination >> 8) & 0x00FF00FFu) << 8;
+		}
+
+		// The layers' 8-bit color over one back buffer pixel. Formats without a byte per channel have nothing
+		// to blend in place and go through SDL
+		inline uint32_t BlendPixel(const PixelFormat& format, uint32_t destination, uint32_t r, uint32_t g, uint32_t b, uint32_t alpha)
+		{
+			if (format.isPacked) return BlendPacked(destination, format.PackBytes(r, g, b), alpha);
+
+			uint8_t destinationR, destinationG, destinationB;
+			SDL_GetRGB(destination, format.pFormat, &destinationR, &destinationG, &destinationB);
+			return SDL_MapRGB(format.pFormat, uint8_t(BlendChannel8(r, destinationR, alpha)), uint8_t(BlendChannel8(g, destinationG, alpha)), uint8_t(BlendChannel8(b, destinationB, alpha)));
+		}
+
+#if defined(__AVX2__)
+		// BlendChannel8 on every byte of 8 packed pixels, alpha holds each pixel's alpha in its low byte.
+		// The products stay below 2^16, so the whole blend runs in 16-bit lanes
+		inline __m256i BlendPacked8(__m256i destination, __m256i source, __m256i alpha)
+		{
+			const __m256i broadcast = _mm256_setr_epi8(
+				0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12,
+				0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12);
+			const __m256i alphaBytes = _mm256_shuffle_epi8(alpha, broadcast);
+			const __m256i zero = _mm256_setzero_si256();
+
+			auto blendHalf = [](__m256i source16, __m256i destination16, __m256i alpha16)
+				{
+					const __m256i inverseAlpha16 = _mm256_sub_epi16(_mm256_set1_epi16(255), alpha16);
+					const __m256i t = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(source16, alpha16), _mm256_mullo_epi16(destination16, inverseAlpha16)), _mm256_set1_epi16(128));
+					return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+				};
+
+			// Unpack and pack both work per 128-bit half, so the pixel order survives
+			const __m256i low = blendHalf(_mm256_unpacklo_epi8(source, zero), _mm256_unpacklo_epi8(destination, zero), _mm256_unpacklo_epi8(alphaBytes, zero));
+			const __m256i high = blendHalf(_mm256_unpackhi_epi8(source, zero), _mm256_unpackhi_epi8(destination, zero), _mm256_unpackhi_epi8(alphaBytes, zero));
+			return _mm256_packus_epi16(low, high);
+		}
+
+		// Four sums below 2^52 to floats: or-ing in the exponent of 2^52 makes them doubles offset by 2^52
+		inline __m128 ToFloat4(__m256i value)
+		{
+			const __m256d magic = _mm256_set1_pd(4503599627370496.0);
+			return _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(value, _mm256_castpd_si256(magic))), magic));
+		}
+
+		inline __m256 ToFloat8(const uint64_t* pValues)
+		{
+			const __m128 low = ToFloat4(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pValues)));
+			const __m128 high = ToFloat4(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pValues + 4)));
+			return _mm256_set_m128(high, low);
+		}
+
+		// 2^x for x <= 0, degree 5 Taylor polynomial on the fraction, relative error below 1.6e-4
+		inline __m256 Exp2Negative8(__m256 x)
+		{
+			x = _mm256_max_ps(x, _mm256_set1_ps(-126.f));
+			const __m256 whole = _mm256_floor_ps(x);
+			const __m256 fraction = _mm256_sub_ps(x, whole);
+
+			__m256 polynomial = _mm256_set1_ps(1.333356e-3f);
+			polynomial = _mm256_fmadd_ps(polynomial, fraction, _mm256_set1_ps(9.618129e-3f));
+			polynomial = _mm256_fmadd_ps(polynomial, fraction, _mm256_set1_ps(5.550411e-2f));
+			polynomial = _mm256_fmadd_ps(polynomial, fraction, _mm256_set1_ps(2.402265e-1f));
+			polynomial = _mm256_fmadd_ps(polynomial, fraction, _mm256_set1_ps(6.931472e-1f));
+			polynomial = _mm256_fmadd_ps(polynomial, fraction, _mm256_set1_ps(1.f));
+
+			const __m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(whole), _mm256_set1_epi32(127)), 23);
+			return _mm256_mul_ps(polynomial, _mm256_castsi256_ps(exponent));
+		}
+
+		// 0-1 to rounded 0-255
+		inline __m256i ToByte(__m256 value)
+		{
+			value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+			return _mm256_cvtps_epi32(_mm256_mul_ps(value, _mm256_set1_ps(255.f)));
+		}
+#endif
+	}
+
+	TransparencyBuffer::TransparencyBuffer(int width, int height, int downscale)
+		: m_Downscale{ std::max(downscale, 1) }
+		, m_TargetWidth{ width }
+		, m_TargetHeight{ height }
+		, m_Width{ (width + m_Downscale - 1) / m_Downscale }
+		, m_Height{ (height + m_Downscale - 1) / m_Downscale }
+		, m_PixelCount{ m_Downscale == 1 ? FrameBuffer::GetTiledPixelCount(width, height) : m_Width * m_Height }
+		, m_AccumulationR(size_t(m_PixelCount), 0)
+		, m_AccumulationG(size_t(m_PixelCount), 0)
+		, m_AccumulationB(size_t(m_PixelCount), 0)
+		, m_AccumulationA(size_t(m_PixelCount), 0)
+		, m_Revealage(size_t(m_PixelCount), 0)
+	{
+		if (m_Downscale == 1) return;
+
+		m_Depth.resize(size_t(m_Width) * m_Height);
+		m_ResolvedColor.resize(size_t(m_Width) * m_Height);
+		m_ResolvedCoverage.resize(size_t(m_Width) * m_Height);
+	}
+
+	int TransparencyBuffer::GetWidth() const
+	{
+		return m_Width;
+	}
+
+	int TransparencyBuffer::GetHeight() const
+	{
+		return m_Height;
+	}
+
+	void* TransparencyBuffer::DownsampleDepth(FrameBuffer& frameBuffer)
+	{
+		m_DepthFormat = frameBuffer.GetDepthFormat();
+		if (m_Downscale == 1) return frameBuffer.GetDepthPixels();
+
+		DispatchDepthFormat(m_DepthFormat, [&](auto format)
+			{
+				using Traits = DepthTraits<decltype(format)::value>;
+				const typename Traits::Storage* pDepthBuffer = frameBuffer.GetDepthPixels<decltype(format)::value>();
+				const FrameBuffer::Layout layout = frameBuffer.GetLayout();
+				typename Traits::Storage* pDepth = reinterpret_cast<typename Traits::Storage*>(m_Depth.data());
+
+#pragma omp parallel for
+				for (int y = 0; y < m_Height; ++y)
+				{
+					const int maxTargetY = std::min((y + 1) * m_Downscale, m_TargetHeight);
+					for (int x = 0; x < m_Width; ++x)
+					{
+						const int maxTargetX = std::min((x + 1) * m_Downscale, m_TargetWidth);
+
+						// No opaque draw touched the tile, it still only holds the clear depth
+						if (!frameBuffer.IsTouched(x * m_Downscale, y * m_Downscale))
+						{
+							pDepth[size_t(y) * m_Width + x] = Traits::Clear;
+							continue;
+						}
+
+						// The value every other one of the block passes against
+						typename Traits::Storage farthest = pDepthBuffer[layout.GetIndex(x * m_Downscale, y * m_Downscale)];
+						for (int targetY = y * m_Downscale; targetY < maxTargetY; ++targetY)
+						{
+							for (int targetX = x * m_Downscale; targetX < maxTargetX; ++targetX)
+							{
+								const typename Traits::Storage depth = pDepthBuffer[layout.GetIndex(targetX, targetY)];
+								if (Traits::Passes(farthest, depth)) farthest = depth;
+							}
+						}
+						pDepth[size_t(y) * m_Width + x] = farthest;
+					}
+				}
+			});
+		return m_Depth.data();
+	}
+
+	void TransparencyBuffer::Accumulate(int pixelIndex, const ColorRGB& color, float alpha, float viewDepth)
+	{
+		alpha = Saturate(alpha);
+		if (alpha <= 0.f) return;
+
+		// Every fragment rounds on its own, the sums themselves are exact and so independent of the order
+		const double scale = double(alpha * GetDepthWeight(viewDepth)) * AccumulationScale;
+		std::atomic_ref<uint64_t>(m_AccumulationR[pixelIndex]).fetch_add(uint64_t(Saturate(color.r) * scale), std::memory_order_relaxed);
+		std::atomic_ref<uint64_t>(m_AccumulationG[pixelIndex]).fetch_add(uint64_t(Saturate(color.g) * scale), std::memory_order_relaxed);
+		std::atomic_ref<uint64_t>(m_AccumulationB[pixelIndex]).fetch_add(uint64_t(Saturate(color.b) * scale), std::memory_order_relaxed);
+		std::atomic_ref<uint64_t>(m_AccumulationA[pixelIndex]).fetch_add(uint64_t(scale), std::memory_order_relaxed);
+
+		const float coverage = -std::log2(1.f - std::min(alpha, MaxAlpha));
+		std::atomic_ref<uint64_t>(m_Revealage[pixelIndex]).fetch_add(uint64_t(coverage * RevealageScale + .5f), std::memory_order_relaxed);
+	}
+
+	void TransparencyBuffer::Composite(const PixelFormat& backBufferFormat, FrameBuffer& frameBuffer, float nearPlane, float farPlane)
+	{
+		// At full resolution every covered pixel lies under a transparent triangle, whose draw touched its tile already.
+		// The layers were accumulated in the frame buffer's layout, so they composite index for index
+		if (m_Downscale == 1)
+		{
+			CompositeFullResolution(backBufferFormat, frameBuffer.GetColorPixels());
+		}
+		else
+		{
+			CompositeUpsampled(backBufferFormat, frameBuffer, nearPlane, farPlane);
+		}
+	}
+
+	void TransparencyBuffer::CompositeFullResolution(const PixelFormat& backBufferFormat, uint32_t* pBackBufferPixels)
+	{
+		const int pixelCount = m_PixelCount;
+
+		// Average color of the layers over what they leave of the background
+		auto compositePixel = [&](int pixelIndex)
+			{
+				const uint64_t accumulationA = m_AccumulationA[pixelIndex];
+				if (accumulationA == 0) return;
+
+				// Layer color and coverage go to 8 bits once, the blend itself is integer
+				const double inverseA = 255.0 / double(accumulationA);
+				const uint32_t coverage = uint32_t(std::lround(255.f * (1.f - std::exp2(-float(m_Revealage[pixelIndex]) / RevealageScale))));
+				auto toByte = [inverseA](uint64_t accumulation) { return uint32_t(std::min(std::lround(double(accumulation) * inverseA), 255l)); };
+
+				pBackBufferPixels[pixelIndex] = BlendPixel(backBufferFormat, pBackBufferPixels[pixelIndex],
+					toByte(m_AccumulationR[pixelIndex]), toByte(m_AccumulationG[pixelIndex]), toByte(m_AccumulationB[pixelIndex]), coverage);
+
+				m_AccumulationR[pixelIndex] = 0;
+				m_AccumulationG[pixelIndex] = 0;
+				m_AccumulationB[pixelIndex] = 0;
+				m_AccumulationA[pixelIndex] = 0;
+				m_Revealage[pixelIndex] = 0;
+			};
+
+		int firstScalarPixel = 0;
+#if defined(__AVX2__)
+		// 8-bit channels are unpacked and packed with shifts, other formats take the scalar loop
+		if (backBufferFormat.isPacked)
+		{
+			const int redShift = backBufferFormat.redShift;
+			const int greenShift = backBufferFormat.greenShift;
+			const int blueShift = backBufferFormat.blueShift;
+			const __m256i alphaMask = _mm256_set1_epi32(int(backBufferFormat.alphaMask));
+			const int vectorPixelCount = pixelCount / 8 * 8;
+
+#pragma omp parallel for
+			for (int pixelIndex = 0; pixelIndex < vectorPixelCount; pixelIndex += 8)
+			{
+				const __m256 accumulationA = ToFloat8(&m_AccumulationA[pixelIndex]);
+				const __m256 isCovered = _mm256_cmp_ps(accumulationA, _mm256_setzero_ps(), _CMP_GT_OQ);
+				if (_mm256_movemask_ps(isCovered) == 0) continue;
+
+				// Uncovered lanes divide by zero, the blend below discards them
+				const __m256 inverseA = _mm256_div_ps(_mm256_set1_ps(1.f), accumulationA);
+				// Exact below 2^52, far past full coverage; Exp2Negative8 clamps the large sums to 0
+				const __m256 revealageSum = ToFloat8(&m_Revealage[pixelIndex]);
+				const __m256 revealage = Exp2Negative8(_mm256_mul_ps(revealageSum, _mm256_set1_ps(-1.f / RevealageScale)));
+				const __m256i coverage = ToByte(_mm256_sub_ps(_mm256_set1_ps(1.f), revealage));
+
+				// The averaged layers as one packed source pixel, blended over the background in 8-bit integers
+				auto packChannel = [&](const uint64_t* pAccumulation, int shift)
+					{
+						const __m256 layer = _mm256_mul_ps(ToFloat8(pAccumulation + pixelIndex), inverseA);
+						return _mm256_sll_epi32(ToByte(layer), _mm_cvtsi32_si128(shift));
+					};
+
+				const __m256i layers = _mm256_or_si256(_mm256_or_si256(
+					packChannel(m_AccumulationR.data(), redShift),
+					packChannel(m_AccumulationG.data(), greenShift)), _mm256_or_si256(
+					packChannel(m_AccumulationB.data(), blueShift), alphaMask));
+
+				__m256i* pPixels = reinterpret_cast<__m256i*>(pBackBufferPixels + pixelIndex);
+				const __m256i background = _mm256_loadu_si256(pPixels);
+				const __m256i result = BlendPacked8(background, layers, coverage);
+				_mm256_storeu_si256(pPixels, _mm256_blendv_epi8(background, result, _mm256_castps_si256(isCovered)));
+
+				const __m256i zero = _mm256_setzero_si256();
+				for (std::vector<uint64_t>* pAccumulation : { &m_AccumulationR, &m_AccumulationG, &m_AccumulationB, &m_AccumulationA })
+				{
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(pAccumulation->data() + pixelIndex), zero);
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(pAccumulation->data() + pixelIndex + 4), zero);
+				}
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(&m_Revealage[pixelIndex]), zero);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(&m_Revealage[pixelIndex + 4]), zero);
+			}
+			firstScalarPixel = vectorPixelCount;
+		}
+#endif
+
+#pragma omp parallel for
+		for (int pixelIndex = firstScalarPixel; pixelIndex < pixelCount; ++pixelIndex)
+		{
+			compositePixel(pixelIndex);
+		}
+	}
+
+	void TransparencyBuffer::CompositeUpsampled(const PixelFormat& backBufferFormat, FrameBuffer& frameBuffer, float nearPlane, float farPlane)
+	{
+		uint32_t* pBackBufferPixels = frameBuffer.GetColorPixels();
+		const void* pDepthBuffer = frameBuffer.GetDepthPixels();
+		const FrameBuffer::Layout layout = frameBuffer.GetLayout();
+
+		// Resolve at the layers' own resolution first, the upsample then filters plain colors
+#pragma omp parallel for
+		for (int pixelIndex = 0; pixelIndex < m_Width * m_Height; ++pixelIndex)
+		{
+			const uint64_t accumulationA = m_AccumulationA[pixelIndex];
+			if (accumulationA == 0)
+			{
+				m_ResolvedColor[pixelIndex] = ColorRGB{ 0.f, 0.f, 0.f };
+				m_ResolvedCoverage[pixelIndex] = 0.f;
+				continue;
+			}
+
+			const float coverage = 1.f - std::exp2(-float(m_Revealage[pixelIndex]) / RevealageScale);
+			const double scale = coverage / double(accumulationA);
+			m_ResolvedColor[pixelIndex] = ColorRGB{ float(m_AccumulationR[pixelIndex] * scale), float(m_AccumulationG[pixelIndex] * scale), float(m_AccumulationB[pixelIndex] * scale) };
+			m_ResolvedCoverage[pixelIndex] = coverage;
+
+			m_AccumulationR[pixelIndex] = 0;
+			m_AccumulationG[pixelIndex] = 0;
+			m_AccumulationB[pixelIndex] = 0;
+			m_AccumulationA[pixelIndex] = 0;
+			m_Revealage[pixelIndex] = 0;
+		}
+
+		// The low resolution draw never touched the full resolution tiles, each one any covered sample
+		// filters into is touched once here instead of per pixel below
+		const int tilesWide = (m_TargetWidth + FrameBuffer::TileSize - 1) / FrameBuffer::TileSize;
+		const int tilesHigh = (m_TargetHeight + FrameBuffer::TileSize - 1) / FrameBuffer::TileSize;
+#pragma omp parallel for
+		for (int tileIndex = 0; tileIndex < tilesWide * tilesHigh; ++tileIndex)
+		{
+			const int minX = (tileIndex % tilesWide) * FrameBuffer::TileSize;
+			const int minY = (tileIndex / tilesWide) * FrameBuffer::TileSize;
+			const int maxX = std::min(minX + FrameBuffer::TileSize, m_TargetWidth);
+			const int maxY = std::min(minY + FrameBuffer::TileSize, m_TargetHeight);
+
+			// The bilinear footprint reaches one sample past the ones the tile's pixels fall in
+			const int minSampleX = std::max(minX / m_Downscale - 1, 0);
+			const int minSampleY = std::max(minY / m_Downscale - 1, 0);
+			const int maxSampleX = std::min((maxX - 1) / m_Downscale + 1, m_Width - 1);
+			const int maxSampleY = std::min((maxY - 1) / m_Downscale + 1, m_Height - 1);
+
+			bool isCovered{ false };
+			for (int sampleY = minSampleY; sampleY <= maxSampleY && !isCovered; ++sampleY)
+			{
+				for (int sampleX = minSampleX; sampleX <= maxSampleX && !isCovered; ++sampleX)
+				{
+					isCovered = m_ResolvedCoverage[size_t(sampleY) * m_Width + sampleX] > 0.f;
+				}
+			}
+			if (isCovered) frameBuffer.Touch(minX, minY, maxX, maxY);
+		}
+
+		// Depth buffer to view depth, the cleared background as the far plane
+		auto toViewDepth = [nearPlane, farPlane](float depth)
+			{
+				return nearPlane * farPlane / (farPlane - std::min(depth, 1.f) * (farPlane - nearPlane));
+			};
+
+#pragma omp parallel for
+		for (int targetY = 0; targetY < m_TargetHeight; ++targetY)
+		{
+			// The four nearest low resolution samples and their bilinear weights, clamped at the borders
+			const float sampleY = std::clamp((targetY + .5f) / m_Downscale - .5f, 0.f, float(m_Height - 1));
+			const int y0 = int(sampleY);
+			const int y1 = std::min(y0 + 1, m_Height - 1);
+			const float fractionY = sampleY - y0;
+
+			for (int targetX = 0; targetX < m_TargetWidth; ++targetX)
+			{
+				const float sampleX = std::clamp((targetX + .5f) / m_Downscale - .5f, 0.f, float(m_Width - 1));
+				const int x0 = int(sampleX);
+				const int x1 = std::min(x0 + 1, m_Width - 1);
+				const float fractionX = sampleX - x0;
+
+				const int sampleIndices[4]{ y0 * m_Width + x0, y0 * m_Width + x1, y1 * m_Width + x0, y1 * m_Width + x1 };
+				if (m_ResolvedCoverage[sampleIndices[0]] + m_ResolvedCoverage[sampleIndices[1]] + m_ResolvedCoverage[sampleIndices[2]] + m_ResolvedCoverage[sampleIndices[3]] <= 0.f) continue;
+
+				const float bilinearWeights[4]{ (1.f - fractionX) * (1.f - fractionY), fractionX * (1.f - fractionY), (1.f - fractionX) * fractionY, fractionX * fractionY };
+
+				// Samples whose opaque depth differs from this pixel's were tested against another surface, across a
+				// silhouette they would bleed the layers over or under the wrong side of the edge
+				const int targetIndex = layout.GetIndex(targetX, targetY);
+				const float viewDepth = toViewDepth(DecodeDepth(m_DepthFormat, pDepthBuffer, targetIndex));
+
+				ColorRGB color{};
+				float coverage{};
+				float weightSum{};
+				float minDepthDifference{ FLT_MAX };
+				for (int i = 0; i < 4; ++i)
+				{
+					const float depthDifference = std::abs(toViewDepth(DecodeDepth(m_DepthFormat, m_Depth.data(), sampleIndices[i])) - viewDepth) / viewDepth;
+					const float weight = bilinearWeights[i] / (1e-4f + depthDifference * depthDifference);
+					color += m_ResolvedColor[sampleIndices[i]] * weight;
+					coverage += m_ResolvedCoverage[sampleIndices[i]] * weight;
+					weightSum += weight;
+					minDepthDifference = std::min(minDepthDifference, depthDifference);
+				}
+
+				// Every sample lies on another surface, e.g. a thin opaque feature the farthest depth of each block
+				// dropped; normalizing would paint the layers over it at full strength, so the pixel keeps its own color
+				if (coverage <= 0.f || minDepthDifference > MaxUpsampleDepthDifference) continue;
+
+				// Premultiplied, so dividing by the coverage gives the layers' own color
+				const uint32_t coverageByte = uint32_t(std::lround(255.f * std::min(coverage / weightSum, 1.f)));
+				const float inverseCoverage = 255.f / coverage;
+				auto toByte = [inverseCoverage](float value) { return uint32_t(std::clamp(std::lround(value * inverseCoverage), 0l, 255l)); };
+
+				pBackBufferPixels[targetIndex] = BlendPixel(backBufferFormat, pBackBufferPixels[targetIndex], toByte(color.r), toByte(color.g), toByte(color.b), coverageByte);
+			}
+		}
+	}
+}
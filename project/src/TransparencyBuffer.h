@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "ColorRGB.h"
+#include "PixelFormat.h"
+#include "FrameBuffer.h"
+
+namespace dae
+{
+	// Weighted blended order-independent transparency. Fragments add into fixed-point sums,
+	// so any rasterization order, triangle-parallel included, composites to the same image
+	class TransparencyBuffer final
+	{
+	public:
+		// width and height are the back buffer's, a downscale of 2 keeps the layers at a quarter of its pixels
+		TransparencyBuffer(int width, int height, int downscale = 1);
+		~TransparencyBuffer() = default;
+
+		TransparencyBuffer(const TransparencyBuffer&) = delete;
+		TransparencyBuffer(TransparencyBuffer&&) noexcept = delete;
+		TransparencyBuffer& operator=(const TransparencyBuffer&) = delete;
+		TransparencyBuffer& operator=(TransparencyBuffer&&) noexcept = delete;
+
+		// Resolution the transparent draws rasterize at
+		int GetWidth() const;
+		int GetHeight() const;
+
+		// Depth buffer the transparent draws test against: the opaque one itself at full resolution,
+		// otherwise the farthest opaque depth of each block, so no layer in front of any of its pixels is lost
+		// in the frame buffer's depth format
+		void* DownsampleDepth(FrameBuffer& frameBuffer);
+
+		// Thread-safe, color is not premultiplied and viewDepth is the fragment's view space depth.
+		// pixelIndex is in the draw's layout, the frame buffer's at full resolution
+		void Accumulate(int pixelIndex, const ColorRGB& color, float alpha, float viewDepth);
+
+		// Resolves the transparent layers over the back buffer and clears them for the next frame.
+		// Downscaled layers are upsampled favoring the samples nearest in depth to the opaque pixel underneath
+		void Composite(const PixelFormat& backBufferFormat, FrameBuffer& frameBuffer, float nearPlane, float farPlane);
+
+	private:
+		// Weights are normalized to at most 1, one full-weight fragment adds 2^32; the composite converts
+		// through doubles, exact below 2^52, so about a million full-weight layers per pixel
+		static constexpr double AccumulationScale{ 4294967296.0 };
+		// Revealage is the product of (1 - alpha), kept as the sum of -log2(1 - alpha) so it adds exactly too.
+		// A fragment adds at most 10 * RevealageScale, the 64-bit sums cannot wrap back to uncovered
+		static constexpr float RevealageScale{ 65536.f };
+		static constexpr float MaxAlpha{ 1.f - 1.f / 1024.f };
+		// Relative view depth difference beyond which a low resolution sample is taken to lie on another surface
+		static constexpr float MaxUpsampleDepthDifference{ .05f };
+
+		int m_Downscale{};
+		int m_TargetWidth{};
+		int m_TargetHeight{};
+		int m_Width{};
+		int m_Height{};
+		int m_PixelCount{};	// at full resolution the frame buffer's tiled storage, padding included
+
+		std::vector<uint64_t> m_AccumulationR{};
+		std::vector<uint64_t> m_AccumulationG{};
+		std::vector<uint64_t> m_AccumulationB{};
+		std::vector<uint64_t> m_AccumulationA{};
+		std::vector<uint64_t> m_Revealage{};
+
+		// Downscaled only: the depth the layers were tested against, and the layers resolved ahead of the upsample
+		DepthFormat m_DepthFormat{};
+		std::vector<uint32_t> m_Depth{};	// room for 32 bits per pixel, any format fits
+		std::vector<ColorRGB> m_ResolvedColor{};	// premultiplied by the coverage
+		std::vector<float> m_ResolvedCoverage{};
+
+		void CompositeFullResolution(const PixelFormat& backBufferFormat, uint32_t* pBackBufferPixels);
+		void CompositeUpsampled(const PixelFormat& backBufferFormat, FrameBuffer& frameBuffer, float nearPlane, float farPlane);
+	};
+}
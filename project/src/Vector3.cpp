@@ -31,18 +31,19 @@ namespace dae {
 
 	float Vector3::Normalize()
 	{
-		const float m = Magnitude();
-		x /= m;
-		y /= m;
-		z /= m;
+		const float sqrMagnitude = SqrMagnitude();
+		const float inverseMagnitude = InverseSqrt(sqrMagnitude);
+		x *= inverseMagnitude;
+		y *= inverseMagnitude;
+		z *= inverseMagnitude;
 
-		return m;
+		return sqrMagnitude * inverseMagnitude;
 	}
 
 	Vector3 Vector3::Normalized() const
 	{
-		const float m = Magnitude();
-		return { x / m, y / m, z / m };
+		const float inverseMagnitude = InverseSqrt(SqrMagnitude());
+		return { x * inverseMagnitude, y * inverseMagnitude, z * inverseMagnitude };
 	}
 
 	float Vector3::Dot(const Vector3& v1, const Vector3& v2)
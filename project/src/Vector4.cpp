@@ -24,19 +24,20 @@ namespace dae
 
 	float Vector4::Normalize()
 	{
-		const float m = Magnitude();
-		x /= m;
-		y /= m;
-		z /= m;
-		w /= m;
-
-		return m;
+		const float sqrMagnitude = SqrMagnitude();
+		const float inverseMagnitude = InverseSqrt(sqrMagnitude);
+		x *= inverseMagnitude;
+		y *= inverseMagnitude;
+		z *= inverseMagnitude;
+		w *= inverseMagnitude;
+
+		return sqrMagnitude * inverseMagnitude;
 	}
 
 	Vector4 Vector4::Normalized() const
 	{
-		const float m = Magnitude();
-		return { x / m, y / m, z / m, w / m };
+		const float inverseMagnitude = InverseSqrt(SqrMagnitude());
+		return { x * inverseMagnitude, y * inverseMagnitude, z * inverseMagnitude, w * inverseMagnitude };
 	}
 
 	Vector2 Vector4::GetXY() const
@@ -77,51 +77,6 @@ VehicleEffect::VehicleEffect(ID3D11Device* pDevice, const std::wstring& assetFil
 		m_EffectSamplerVariable->SetSampler(0, m_pSamplerAnisotropic);
 	}
 
-
-	m_pUDiffuseTexture = Texture::LoadFromFile(pDevice, "resources/vehicle_diffuse.png");
-	ID3DX11EffectShaderResourceVariable* pDiffuseMapVariable = m_pEffect->GetVariableByName("gDiffuseMap")->AsShaderResource();
-	if (pDiffuseMapVariable->IsValid()) {
-		pDiffuseMapVariable->SetResource(m_pUDiffuseTexture.get()->GetShaderResourceView());
-	}
-	else
-	{
-		std::wcout << L"m_pDiffuseMapVariable not valid!\n";
-	}
-
-	m_pUNormalTexture = Texture::LoadFromFile(pDevice, "resources/vehicle_normal.png");
-	ID3DX11EffectShaderResourceVariable*  pNormalMapVariable = m_pEffect->GetVariableByName("gNormalMap")->AsShaderResource();
-	if (pNormalMapVariable->IsValid())
-	{
-		pNormalMapVariable->SetResource(m_pUNormalTexture.get()->GetShaderResourceView());
-	}
-	else
-	{
-		std::wcout << L"m_pNormalMapVariable not valid!\n";
-	}
-
-	m_pUSpecularTexture = Texture::LoadFromFile(pDevice, "resources/vehicle_specular.png");
-	ID3DX11EffectShaderResourceVariable*  pSpecularMapVariable = m_pEffect->GetVariableByName("gSpecularMap")->AsShaderResource();
-	if (pSpecularMapVariable->IsValid())
-	{
-		pSpecularMapVariable->SetResource(m_pUSpecularTexture.get()->GetShaderResourceView());
-		
-	}
-	else
-	{
-		std::wcout << L"m_pSpecularMapVariable not valid!\n";
-	}
-
-	m_pUGlossinessTexture = Texture::LoadFromFile(pDevice, "resources/vehicle_gloss.png");
-	ID3DX11EffectShaderResourceVariable* pGlossinessMapVariable = m_pEffect->GetVariableByName("gGlossinessMap")->AsShaderResource();
-	if (pGlossinessMapVariable->IsValid())
-	{
-		pGlossinessMapVariable->SetResource(m_pUGlossinessTexture.get()->GetShaderResourceView());
-	}
-	else
-	{
-		std::wcout << L"m_pGlossinessMapVariable not valid!\n";
-	}
-
 }
 
 VehicleEffect::~VehicleEffect()
@@ -193,6 +148,62 @@ void VehicleEffect::SetAnisotropicSampling()
 	}
 }
 
+void VehicleEffect::SetMaps(std::unique_ptr<Texture> pDiffuseTexture, std::unique_ptr<Texture> pNormalTexture, std::unique_ptr<Texture> pSpecularTexture, std::unique_ptr<Texture> pGlossinessTexture)
+{
+	m_pUDiffuseTexture = std::move(pDiffuseTexture);
+	ID3DX11EffectShaderResourceVariable* pDiffuseMapVariable = m_pEffect->GetVariableByName("gDiffuseMap")->AsShaderResource();
+	if (pDiffuseMapVariable->IsValid()) {
+		pDiffuseMapVariable->SetResource(m_pUDiffuseTexture.get()->GetShaderResourceView());
+	}
+	else
+	{
+		std::wcout << L"m_pDiffuseMapVariable not valid!\n";
+	}
+
+	m_pUNormalTexture = std::move(pNormalTexture);
+	ID3DX11EffectShaderResourceVariable*  pNormalMapVariable = m_pEffect->GetVariableByName("gNormalMap")->AsShaderResource();
+	if (pNormalMapVariable->IsValid())
+	{
+		pNormalMapVariable->SetResource(m_pUNormalTexture.get()->GetShaderResourceView());
+	}
+	else
+	{
+		std::wcout << L"m_pNormalMapVariable not valid!\n";
+	}
+
+	m_pUSpecularTexture = std::move(pSpecularTexture);
+	ID3DX11EffectShaderResourceVariable*  pSpecularMapVariable = m_pEffect->GetVariableByName("gSpecularMap")->AsShaderResource();
+	if (pSpecularMapVariable->IsValid())
+	{
+		pSpecularMapVariable->SetResource(m_pUSpecularTexture.get()->GetShaderResourceView());
+		
+	}
+	else
+	{
+		std::wcout << L"m_pSpecularMapVariable not valid!\n";
+	}
+
+	m_pUGlossinessTexture = std::move(pGlossinessTexture);
+	ID3DX11EffectShaderResourceVariable* pGlossinessMapVariable = m_pEffect->GetVariableByName("gGlossinessMap")->AsShaderResource();
+	if (pGlossinessMapVariable->IsValid())
+	{
+		pGlossinessMapVariable->SetResource(m_pUGlossinessTexture.get()->GetShaderResourceView());
+	}
+	else
+	{
+		std::wcout << L"m_pGlossinessMapVariable not valid!\n";
+	}
+
+	//Interleaved copy of all maps for the software rasterizer
+	m_pUMaterial = MaterialTexture::Pack(m_pUDiffuseTexture.get(), m_pUNormalTexture.get(), m_pUSpecularTexture.get(), m_pUGlossinessTexture.get());
+
+	// The software path only samples the material, the maps keep just their GPU resources
+	m_pUDiffuseTexture->ReleaseCPUCopy();
+	m_pUNormalTexture->ReleaseCPUCopy();
+	m_pUSpecularTexture->ReleaseCPUCopy();
+	m_pUGlossinessTexture->ReleaseCPUCopy();
+}
+
 Texture* VehicleEffect::GetDiffuseTexture()
 {
 	return  m_pUDiffuseTexture.get();
@@ -213,6 +224,11 @@ Texture* VehicleEffect::GetGlossinessTexture()
 	return m_pUGlossinessTexture.get();
 }
 
+MaterialTexture* VehicleEffect::GetMaterial()
+{
+	return m_pUMaterial.get();
+}
+
 void VehicleEffect::Update(const Vector3& cameraPosition, const Matrix& pWorldMatrix, const Matrix& pWorldViewProjectionMatrix)
 {
 	Effect::Update(cameraPosition, pWorldMatrix, pWorldViewProjectionMatrix);
@@ -17,10 +17,13 @@ public:
 	void SetLinearSampling();
     void SetAnisotropicSampling();
 
+    void SetMaps(std::unique_ptr<Texture> pDiffuseTexture, std::unique_ptr<Texture> pNormalTexture, std::unique_ptr<Texture> pSpecularTexture, std::unique_ptr<Texture> pGlossinessTexture);
+
     Texture* GetDiffuseTexture() override;
     Texture* GetNormalTexture() override;
     Texture* GetSpecularTexture() override;
     Texture* GetGlossinessTexture() override;
+    MaterialTexture* GetMaterial() override;
 
     void Update(const Vector3& cameraPosition, const Matrix& pWorldMatrix, const Matrix& pWorldViewProjectionMatrix) override;
 
@@ -38,4 +41,6 @@ protected:
     std::unique_ptr<Texture> m_pUSpecularTexture;
     std::unique_ptr<Texture> m_pUGlossinessTexture;
 
+    std::unique_ptr<MaterialTexture> m_pUMaterial;
+
 };
@@ -0,0 +1,349 @@
+#include "VirtualTexture.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+
+namespace dae
+{
+	namespace
+	{
+		std::atomic<uint32_t> g_NextVirtualTextureId{ 1 };
+	}
+
+	// ---- PageCache ----
+
+	PageCache::PageCache(size_t budgetInBytes) :
+		m_Budget(budgetInBytes)
+	{
+	}
+
+	void PageCache::SetBudget(size_t budgetInBytes)
+	{
+		m_Budget = budgetInBytes;
+		EvictToBudget();
+	}
+
+	size_t PageCache::GetBudget() const
+	{
+		return m_Budget;
+	}
+
+	size_t PageCache::GetResidentBytes() const
+	{
+		return m_ResidentBytes;
+	}
+
+	uint32_t PageCache::GetFrameIndex() const
+	{
+		return m_FrameIndex;
+	}
+
+	void PageCache::ResolveFeedback(int maxPagesToLoad)
+	{
+		// Resident pages only move up the LRU, the faults are compacted to the front of the list
+		const uint32_t requestCount = m_RequestCount.exchange(0, std::memory_order_relaxed);
+		uint32_t faultCount{};
+		for (uint32_t i = 0; i < requestCount; ++i)
+		{
+			const PageRequest request = m_Requests[i];
+			if (request.pTexture->m_PageTable[request.pageIndex]) Touch(request.pTexture->GetKey(request.pageIndex));
+			else m_Requests[faultCount++] = request;
+		}
+
+		// Coarse pages first, they cover the most screen area and sharpen the fallback quickest
+		const auto faultsEnd = m_Requests.begin() + faultCount;
+		std::sort(m_Requests.begin(), faultsEnd, [](const PageRequest& a, const PageRequest& b) { return a.mip > b.mip; });
+
+		const uint32_t pagesToLoad = std::min(faultCount, uint32_t(std::max(maxPagesToLoad, 0)));
+		for (uint32_t i = 0; i < pagesToLoad; ++i)
+		{
+			const PageRequest& fault = m_Requests[i];
+			Insert(fault.pTexture, fault.pageIndex, fault.pTexture->ReadPage(fault.pageIndex), fault.pTexture->GetPageSize(fault.pageIndex));
+		}
+
+		EvictToBudget();
+		++m_FrameIndex;
+	}
+
+	void PageCache::Register(VirtualTexture* pTexture)
+	{
+		m_Requests.resize(m_Requests.size() + pTexture->m_PageTable.size());
+	}
+
+	void PageCache::Unregister(VirtualTexture* pTexture)
+	{
+		for (auto it = m_Entries.begin(); it != m_Entries.end();)
+		{
+			if (it->second.pOwner == pTexture)
+			{
+				m_ResidentBytes -= it->second.size;
+				m_LRU.erase(it->second.lruIterator);
+				it = m_Entries.erase(it);
+			}
+			else ++it;
+		}
+
+		// Drops the texture's pending requests along with its slots
+		const auto requestsEnd = m_Requests.begin() + m_RequestCount.load(std::memory_order_relaxed);
+		const auto keptEnd = std::remove_if(m_Requests.begin(), requestsEnd, [pTexture](const PageRequest& request) { return request.pTexture == pTexture; });
+		m_RequestCount.store(uint32_t(keptEnd - m_Requests.begin()), std::memory_order_relaxed);
+		m_Requests.resize(m_Requests.size() - pTexture->m_PageTable.size());
+	}
+
+	void PageCache::PushRequest(VirtualTexture* pTexture, uint32_t pageIndex, int mip)
+	{
+		const uint32_t slot = m_RequestCount.fetch_add(1, std::memory_order_relaxed);
+		assert(slot < m_Requests.size() && "A page was requested twice in one frame");
+		m_Requests[slot] = { pTexture, pageIndex, mip };
+	}
+
+	void PageCache::Touch(uint64_t key)
+	{
+		auto it = m_Entries.find(key);
+		if (it == m_Entries.end()) return;
+
+		m_LRU.splice(m_LRU.begin(), m_LRU, it->second.lruIterator);
+	}
+
+	void PageCache::Insert(VirtualTexture* pTexture, uint32_t pageIndex, std::unique_ptr<uint8_t[]> pData, size_t size)
+	{
+		if (!pData) return;
+
+		const uint64_t key = pTexture->GetKey(pageIndex);
+		m_LRU.push_front(key);
+
+		Entry& entry = m_Entries[key];
+		entry.lruIterator = m_LRU.begin();
+		entry.pData = std::move(pData);
+		entry.size = size;
+		entry.pOwner = pTexture;
+		entry.pageIndex = pageIndex;
+
+		pTexture->m_PageTable[pageIndex] = entry.pData.get();
+		m_ResidentBytes += size;
+	}
+
+	void PageCache::Evict(uint64_t key)
+	{
+		auto it = m_Entries.find(key);
+		if (it == m_Entries.end()) return;
+
+		it->second.pOwner->m_PageTable[it->second.pageIndex] = nullptr;
+		m_ResidentBytes -= it->second.size;
+		m_LRU.erase(it->second.lruIterator);
+		m_Entries.erase(it);
+	}
+
+	void PageCache::EvictToBudget()
+	{
+		while (m_ResidentBytes > m_Budget && !m_LRU.empty())
+		{
+			Evict(m_LRU.back());
+		}
+	}
+
+	// ---- VirtualTexture ----
+
+	VirtualTexture::VirtualTexture(PageCache* pCache, const std::vector<LevelFormat>& levels, const LevelSource& source) :
+		m_pCache(pCache),
+		m_Id(g_NextVirtualTextureId++)
+	{
+		uint32_t pageCount{};
+		int tailMip{ -1 };
+		for (const LevelFormat& format : levels)
+		{
+			assert(PageDimension % format.blockDimension == 0 && "A page has to hold whole blocks");
+
+			MipLevel level{};
+			level.format = format;
+			level.elementsWide = (format.width + format.blockDimension - 1) / format.blockDimension;
+			level.elementsHigh = (format.height + format.blockDimension - 1) / format.blockDimension;
+			level.pageElements = PageDimension / format.blockDimension;
+			level.pagesWide = (level.elementsWide + level.pageElements - 1) / level.pageElements;
+			level.pagesHigh = (level.elementsHigh + level.pageElements - 1) / level.pageElements;
+			level.firstPage = pageCount;
+			m_Mips.push_back(level);
+
+			if (tailMip < 0 && format.width <= PageDimension && format.height <= PageDimension)
+			{
+				tailMip = int(m_Mips.size()) - 1;
+			}
+			else if (tailMip < 0)
+			{
+				pageCount += uint32_t(level.pagesWide * level.pagesHigh);
+			}
+		}
+		assert(tailMip >= 0 && "The last level has to fit in a single page");
+		m_TailMip = tailMip;
+
+		m_PageTable.assign(pageCount, nullptr);
+		m_PageFileOffsets.resize(pageCount);
+		m_PageFeedback = std::vector<std::atomic<uint32_t>>(pageCount);
+
+		// Page file: every page of the finer mips, each stored contiguously row by row.
+		// Levels are written as they are handed over, so no level is ever held here
+		m_PageFilePath = (std::filesystem::temp_directory_path() / ("dae_vt_" + std::to_string(m_Id) + ".pages")).string();
+		{
+			std::ofstream pageFile{ m_PageFilePath, std::ios::binary | std::ios::trunc };
+
+			uint64_t offset{};
+			for (int mip = 0; mip < int(m_Mips.size()); ++mip)
+			{
+				MipLevel& level = m_Mips[mip];
+				const size_t elementSize = size_t(level.format.elementSize);
+
+				size_t pitch{};
+				const uint8_t* pSource = source(mip, pitch);
+
+				// The tail levels are the only ones kept, concatenated
+				if (mip >= m_TailMip)
+				{
+					level.firstPage = uint32_t(m_TailElements.size());
+					for (int row = 0; row < level.elementsHigh; ++row)
+					{
+						const uint8_t* pRow = pSource + row * pitch;
+						m_TailElements.insert(m_TailElements.end(), pRow, pRow + level.elementsWide * elementSize);
+					}
+					continue;
+				}
+
+				for (int pageY = 0; pageY < level.pagesHigh; ++pageY)
+				{
+					for (int pageX = 0; pageX < level.pagesWide; ++pageX)
+					{
+						const uint32_t page = level.firstPage + uint32_t(pageY * level.pagesWide + pageX);
+						const int pageWidth = std::min(level.pageElements, level.elementsWide - pageX * level.pageElements);
+						const int pageHeight = std::min(level.pageElements, level.elementsHigh - pageY * level.pageElements);
+
+						m_PageFileOffsets[page] = offset;
+						for (int row = 0; row < pageHeight; ++row)
+						{
+							const uint8_t* pRow = pSource + size_t(pageY * level.pageElements + row) * pitch + size_t(pageX) * level.pageElements * elementSize;
+							pageFile.write(reinterpret_cast<const char*>(pRow), std::streamsize(pageWidth * elementSize));
+						}
+						offset += uint64_t(pageWidth) * pageHeight * elementSize;
+					}
+				}
+			}
+		}
+
+		m_PageFile.open(m_PageFilePath, std::ios::binary);
+		m_pCache->Register(this);
+	}
+
+	VirtualTexture::~VirtualTexture()
+	{
+		m_pCache->Unregister(this);
+
+		m_PageFile.close();
+		std::error_code error{};
+		std::filesystem::remove(m_PageFilePath, error);
+	}
+
+	VirtualTexture::TexelLocation VirtualTexture::Locate(int x, int y, int mip) const
+	{
+		mip = std::clamp(mip, 0, int(m_Mips.size()) - 1);
+		x = std::clamp(x, 0, m_Mips[mip].format.width - 1);
+		y = std::clamp(y, 0, m_Mips[mip].format.height - 1);
+
+		// The table is only written in ResolveFeedback, between frames, so shading threads read it without locks
+		const uint32_t frameIndex = m_pCache->GetFrameIndex();
+		for (; mip < m_TailMip; ++mip, x >>= 1, y >>= 1)
+		{
+			const MipLevel& level = m_Mips[mip];
+			x = std::min(x, level.format.width - 1);
+			y = std::min(y, level.format.height - 1);
+
+			const int elementX = x / level.format.blockDimension;
+			const int elementY = y / level.format.blockDimension;
+			const int pageX = elementX / level.pageElements;
+			const int pageY = elementY / level.pageElements;
+			const uint32_t page = level.firstPage + uint32_t(pageY * level.pagesWide + pageX);
+
+			// Only write when the value changes so neighbouring samples don't fight over the cache line,
+			// the one thread whose exchange marks the page this frame queues it for ResolveFeedback
+			std::atomic<uint32_t>& feedback = m_PageFeedback[page];
+			uint32_t lastFrame = feedback.load(std::memory_order_relaxed);
+			if (lastFrame != frameIndex && feedback.compare_exchange_strong(lastFrame, frameIndex, std::memory_order_relaxed))
+			{
+				// The cache owns residency, Locate is const only towards the shading threads
+				m_pCache->PushRequest(const_cast<VirtualTexture*>(this), page, mip);
+			}
+
+			if (const uint8_t* pPage = m_PageTable[page])
+			{
+				const int pageWidth = std::min(level.pageElements, level.elementsWide - pageX * level.pageElements);
+				const size_t elementIndex = size_t(elementY - pageY * level.pageElements) * pageWidth + (elementX - pageX * level.pageElements);
+				return { pPage + elementIndex * level.format.elementSize, mip, x, y };
+			}
+		}
+
+		const MipLevel& level = m_Mips[mip];
+		x = std::min(x, level.format.width - 1);
+		y = std::min(y, level.format.height - 1);
+		const size_t elementIndex = size_t(y / level.format.blockDimension) * level.elementsWide + x / level.format.blockDimension;
+		return { m_TailElements.data() + level.firstPage + elementIndex * level.format.elementSize, mip, x, y };
+	}
+
+	const uint8_t* VirtualTexture::FetchTexel(int x, int y, int mip) const
+	{
+		const TexelLocation location = Locate(x, y, mip);
+		assert(m_Mips[location.mip].format.blockDimension == 1 && "Block-compressed levels have to be decoded by the caller");
+		return location.pElement;
+	}
+
+	int VirtualTexture::GetWidth() const
+	{
+		return m_Mips.front().format.width;
+	}
+
+	int VirtualTexture::GetHeight() const
+	{
+		return m_Mips.front().format.height;
+	}
+
+	int VirtualTexture::GetMipCount() const
+	{
+		return int(m_Mips.size());
+	}
+
+	uint64_t VirtualTexture::GetKey(uint32_t pageIndex) const
+	{
+		return uint64_t(m_Id) << 32 | pageIndex;
+	}
+
+	size_t VirtualTexture::GetPageSize(uint32_t pageIndex) const
+	{
+		for (int mip = 0; mip < m_TailMip; ++mip)
+		{
+			const MipLevel& level = m_Mips[mip];
+			const uint32_t localPage = pageIndex - level.firstPage;
+			if (pageIndex < level.firstPage || localPage >= uint32_t(level.pagesWide * level.pagesHigh)) continue;
+
+			const int pageX = int(localPage) % level.pagesWide;
+			const int pageY = int(localPage) / level.pagesWide;
+			const int pageWidth = std::min(level.pageElements, level.elementsWide - pageX * level.pageElements);
+			const int pageHeight = std::min(level.pageElements, level.elementsHigh - pageY * level.pageElements);
+			return size_t(pageWidth) * pageHeight * level.format.elementSize;
+		}
+		return 0;
+	}
+
+	std::unique_ptr<uint8_t[]> VirtualTexture::ReadPage(uint32_t pageIndex)
+	{
+		const size_t size = GetPageSize(pageIndex);
+		if (size == 0) return nullptr;
+
+		auto pData = std::make_unique<uint8_t[]>(size);
+		m_PageFile.seekg(std::streamoff(m_PageFileOffsets[pageIndex]));
+		m_PageFile.read(reinterpret_cast<char*>(pData.get()), std::streamsize(size));
+		if (!m_PageFile)
+		{
+			m_PageFile.clear();
+			return nullptr;
+		}
+		return pData;
+	}
+}
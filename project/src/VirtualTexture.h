@@ -0,0 +1,154 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dae
+{
+	class VirtualTexture;
+
+	// Residency manager shared by every virtual texture, evicts least recently used pages beyond the budget
+	class PageCache final
+	{
+	public:
+		explicit PageCache(size_t budgetInBytes);
+		~PageCache() = default;
+
+		PageCache(const PageCache&) = delete;
+		PageCache(PageCache&&) noexcept = delete;
+		PageCache& operator=(const PageCache&) = delete;
+		PageCache& operator=(PageCache&&) noexcept = delete;
+
+		void SetBudget(size_t budgetInBytes);
+		size_t GetBudget() const;
+		size_t GetResidentBytes() const;
+		uint32_t GetFrameIndex() const;
+
+		// Call between frames: loads the pages faulted while shading and refreshes the LRU order
+		void ResolveFeedback(int maxPagesToLoad = 64);
+
+	private:
+		friend class VirtualTexture;
+
+		struct Entry
+		{
+			std::list<uint64_t>::iterator lruIterator{};
+			std::unique_ptr<uint8_t[]> pData{};
+			size_t size{};
+			VirtualTexture* pOwner{};
+			uint32_t pageIndex{};
+		};
+
+		struct PageRequest
+		{
+			VirtualTexture* pTexture{};
+			uint32_t pageIndex{};
+			int mip{};
+		};
+
+		size_t m_Budget{};
+		size_t m_ResidentBytes{};
+		uint32_t m_FrameIndex{ 1 };
+
+		std::list<uint64_t> m_LRU{};	// most recently used at the front
+		std::unordered_map<uint64_t, Entry> m_Entries{};
+
+		// Pages needed this frame, a page is pushed once per frame so one slot per registered page is enough
+		std::vector<PageRequest> m_Requests{};
+		std::atomic<uint32_t> m_RequestCount{};
+
+		void Register(VirtualTexture* pTexture);
+		void Unregister(VirtualTexture* pTexture);
+		void PushRequest(VirtualTexture* pTexture, uint32_t pageIndex, int mip);
+		void Touch(uint64_t key);
+		void Insert(VirtualTexture* pTexture, uint32_t pageIndex, std::unique_ptr<uint8_t[]> pData, size_t size);
+		void Evict(uint64_t key);
+		void EvictToBudget();
+	};
+
+	// Texture split into fixed pages per mip, backed by a page file and made resident on demand
+	class VirtualTexture final
+	{
+	public:
+		// Storage of one mip, a stored element is a texel or, on block-compressed levels, a whole block
+		struct LevelFormat
+		{
+			int width{};
+			int height{};
+			int blockDimension{ 1 };	// texels per side of an element
+			int elementSize{};			// in bytes
+		};
+
+		// Hands over level mip row by row with pitch bytes between rows, levels are asked for in order
+		// and a level is no longer read once the next one is asked for
+		using LevelSource = std::function<const uint8_t*(int mip, size_t& pitch)>;
+
+		// Where Locate found a texel
+		struct TexelLocation
+		{
+			const uint8_t* pElement{};
+			int mip{};		// coarser than requested while the requested page is not resident
+			int x{};		// texel coordinates inside that mip
+			int y{};
+		};
+
+		static constexpr int PageDimension{ 128 };	// in texels
+
+		// Writes every level's pages straight from the source, only the tail levels are copied
+		VirtualTexture(PageCache* pCache, const std::vector<LevelFormat>& levels, const LevelSource& source);
+		~VirtualTexture();
+
+		VirtualTexture(const VirtualTexture&) = delete;
+		VirtualTexture(VirtualTexture&&) noexcept = delete;
+		VirtualTexture& operator=(const VirtualTexture&) = delete;
+		VirtualTexture& operator=(VirtualTexture&&) noexcept = delete;
+
+		// x and y are texel coordinates of the requested mip
+		// Never fails: a missing page is recorded as a fault and the finest resident coarser mip is returned instead
+		TexelLocation Locate(int x, int y, int mip = 0) const;
+		// Same as Locate, for textures whose levels all store single texels
+		const uint8_t* FetchTexel(int x, int y, int mip = 0) const;
+
+		int GetWidth() const;
+		int GetHeight() const;
+		int GetMipCount() const;
+
+	private:
+		friend class PageCache;
+
+		struct MipLevel
+		{
+			LevelFormat format{};
+			int elementsWide{};
+			int elementsHigh{};
+			int pageElements{};		// elements per page side
+			int pagesWide{};
+			int pagesHigh{};
+			uint32_t firstPage{};	// index into the page table, or offset into the tail for resident mips
+		};
+
+		PageCache* m_pCache;
+		uint32_t m_Id;
+
+		std::vector<MipLevel> m_Mips{};
+		int m_TailMip{};							// this mip and every smaller one never leave memory
+		std::vector<uint8_t> m_TailElements{};
+
+		std::vector<const uint8_t*> m_PageTable{};	// nullptr while the page is not resident
+		std::vector<uint64_t> m_PageFileOffsets{};
+		mutable std::vector<std::atomic<uint32_t>> m_PageFeedback;	// frame the page was last needed
+
+		std::string m_PageFilePath{};
+		std::ifstream m_PageFile{};
+
+		uint64_t GetKey(uint32_t pageIndex) const;
+		size_t GetPageSize(uint32_t pageIndex) const;
+		std::unique_ptr<uint8_t[]> ReadPage(uint32_t pageIndex);
+	};
+}
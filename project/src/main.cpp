@@ -39,18 +39,22 @@ int main(int argc, char* args[])
 	std::cout << YELLOW  << "   [F1]  Toggle Rasterizer Mode (HARDWARE/SOFTWARE)"					<< RESET << std::endl;
 	std::cout << YELLOW  << "   [F2]  Toggle Vehicle Rotation (ON/OFF)"								<< RESET << std::endl;
 	std::cout << YELLOW  << "   [F3]  Toggle FireFX (ON/OFF)"										<< RESET << std::endl;
+	std::cout << YELLOW  << "   [F4]  Cycle Sampler State (POINT/LINEAR/ANISOTROPIC)"				<< RESET << std::endl;
 	std::cout << YELLOW  << "   [F9]  Cycle CullMode (BACK/FRONT/NONE)"								<< RESET << std::endl;
 	std::cout << YELLOW  << "   [F10] Toggle Uniform ClearColor (ON/OFF)"							<< RESET << std::endl;
 	std::cout << YELLOW  << "   [F11] Toggle Print FPS (ON/OFF)"									<< RESET << std::endl << "\n";
 						 
-	std::cout << GREEN   << "[Key Bindings - HARDWARE]"												<< RESET << std::endl;
-	std::cout << GREEN   << "   [F4]  Cycle Sampler State (POINT/LINEAR/ANISOTROPIC)"				<< RESET << std::endl << "\n";
-
 	std::cout << MAGENTA << "[Key Bindings - SOFTWARE]"												<< RESET << std::endl;
-	std::cout << MAGENTA << "   [F5]  Cycle Shading Mode (COMBINED/OBSERVED_AREA/DIFFUSE/SPECULAR)" << RESET << std::endl;
+	std::cout << MAGENTA << "   [F5]  Cycle Shading Mode (COMBINED/GOURAUD/DECOUPLED/OBSERVED_AREA/DIFFUSE/SPECULAR)" << RESET << std::endl;
 	std::cout << MAGENTA << "   [F6]  Toggle NormalMap (ON/OFF)"									<< RESET << std::endl;
 	std::cout << MAGENTA << "   [F7]  Toggle DepthBuffer Visualization (ON/OFF)"					<< RESET << std::endl;
-	std::cout << MAGENTA << "   [F8]  Toggle BoundingBox Visualization (ON/OFF)"					<< RESET << std::endl << "\n" << "\n";
+	std::cout << MAGENTA << "   [F8]  Toggle BoundingBox Visualization (ON/OFF)"					<< RESET << std::endl;
+	std::cout << MAGENTA << "   [F12] Toggle Point Lights (ON/OFF)"									<< RESET << std::endl;
+	std::cout << MAGENTA << "   [H]   Toggle Half Resolution FireFX (ON/OFF)"						<< RESET << std::endl;
+	std::cout << MAGENTA << "   [Z]   Cycle Depth Format (FLOAT32/UNORM16/REVERSED_FLOAT32)"		<< RESET << std::endl;
+	std::cout << MAGENTA << "   [P]   Toggle Async Present (ON/OFF)"								<< RESET << std::endl;
+	std::cout << MAGENTA << "   [L]   Toggle Pipelined Frames (ON/OFF)"								<< RESET << std::endl;
+	std::cout << MAGENTA << "   [K]   Cycle Frames In Flight (1/2/3)"								<< RESET << std::endl << "\n" << "\n";
 
 	//Unreferenced parameters
 	(void)argc;
@@ -161,6 +165,30 @@ int main(int argc, char* args[])
 				{
 					pRenderer->ChangeIsClearColorUniform();
 				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F12)
+				{
+					pRenderer->ChangeIsPointLights();
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_H)
+				{
+					pRenderer->ChangeIsHalfResolutionTransparency();
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_Z)
+				{
+					pRenderer->ChangeDepthFormat();
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_P)
+				{
+					pRenderer->ChangeIsAsyncPresent();
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_L)
+				{
+					pRenderer->ChangeIsPipelined();
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_K)
+				{
+					pRenderer->ChangeFramesInFlight();
+				}
 				if (e.key.keysym.scancode == SDL_SCANCODE_F11)
 				{
 					printFPS = !printFPS;
@@ -0,0 +1,60 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "MathHelpers.h"
+
+using namespace dae;
+
+namespace
+{
+	// Bounds documented in MathHelpers.h, relative to the precise versions; without fast math they are the precise versions
+#if defined(DAE_FAST_MATH)
+	constexpr double InverseSqrtMaxError{ 3.5e-7 };
+	constexpr double ReciprocalMaxError{ 3e-7 };
+#else
+	constexpr double InverseSqrtMaxError{ 0. };
+	constexpr double ReciprocalMaxError{ 0. };
+#endif
+
+	float FromBits(uint32_t bits)
+	{
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	// Largest relative error over [2^-60, 2^60], every exponent with a spread of mantissas
+	template<typename Function, typename Reference>
+	double MaxRelativeError(Function function, Reference reference)
+	{
+		double maxError{};
+		for (uint32_t exponent = 127 - 60; exponent <= 127 + 60; ++exponent)
+		{
+			for (uint32_t mantissa = 0; mantissa < (1u << 23); mantissa += 257)
+			{
+				const float a = FromBits((exponent << 23) | mantissa);
+				const double expected = double(reference(a));
+				const double error = std::abs(double(function(a)) - expected) / expected;
+				if (error > maxError) maxError = error;
+			}
+		}
+		return maxError;
+	}
+
+	bool Check(const char* name, double maxError, double bound)
+	{
+		const bool passed = maxError <= bound;
+		std::printf("%s %s: max relative error %.3g, bound %.3g\n", passed ? "PASS" : "FAIL", name, maxError, bound);
+		return passed;
+	}
+}
+
+int main()
+{
+	bool passed{ true };
+	passed &= Check("InverseSqrt", MaxRelativeError(InverseSqrt, [](float a) { return 1.f / std::sqrt(a); }), InverseSqrtMaxError);
+	passed &= Check("Reciprocal", MaxRelativeError(Reciprocal, [](float a) { return 1.f / a; }), ReciprocalMaxError);
+	return passed ? 0 : 1;
+}
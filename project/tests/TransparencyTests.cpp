@@ -0,0 +1,96 @@
+#include <cstdio>
+#include <vector>
+
+#include "pch.h"
+#include "FrameBuffer.h"
+#include "PixelFormat.h"
+#include "TransparencyBuffer.h"
+
+using namespace dae;
+
+namespace
+{
+	constexpr int Width{ 96 };
+	constexpr int Height{ 32 };
+	constexpr float NearPlane{ .1f };
+	constexpr float FarPlane{ 100.f };
+
+	constexpr float OpaqueViewDepth{ 5.f };
+	constexpr float LayerViewDepth{ 20.f };
+
+	// Only the first two tiles are drawn opaque: a one pixel wide pole, whose 2x2 blocks all keep the background's depth,
+	// and a band whose left edge splits a block. The last tile is only touched by the composite
+	constexpr int OpaqueWidth{ 2 * FrameBuffer::TileSize };
+
+	bool IsOpaque(int x)
+	{
+		return x == 17 || (x >= 41 && x < OpaqueWidth);
+	}
+
+	bool Check(const char* name, bool passed)
+	{
+		std::printf("%s %s\n", passed ? "PASS" : "FAIL", name);
+		return passed;
+	}
+}
+
+// Half resolution layers behind a two-depth edge: the pixels of the near surface keep their color,
+// the background next to them is covered
+int main()
+{
+	SDL_PixelFormat* pSDLFormat = SDL_AllocFormat(SDL_PIXELFORMAT_ARGB8888);
+	const PixelFormat format = PixelFormat::Resolve(pSDLFormat);
+	const uint32_t backgroundColor = format.Pack(ColorRGB{ 0.f, 0.f, 0.f });
+	const uint32_t opaqueColor = format.Pack(ColorRGB{ 0.f, 0.f, 1.f });
+
+	std::vector<uint32_t> presentPixels(size_t(Width) * Height);
+	FrameBuffer frameBuffer{ Width, Height, presentPixels.data() };
+	frameBuffer.SetDepthFormat(DepthFormat::Float32);
+	frameBuffer.Clear(backgroundColor);
+	frameBuffer.Touch(0, 0, OpaqueWidth, Height);
+
+	const FrameBuffer::Layout layout = frameBuffer.GetLayout();
+	float* pDepth = frameBuffer.GetDepthPixels<DepthFormat::Float32>();
+	for (int y = 0; y < Height; ++y)
+	{
+		for (int x = 0; x < OpaqueWidth; ++x)
+		{
+			if (!IsOpaque(x)) continue;
+			frameBuffer.GetColorPixels()[layout.GetIndex(x, y)] = opaqueColor;
+			pDepth[layout.GetIndex(x, y)] = 1.f - GetReversedDepth(OpaqueViewDepth, NearPlane, FarPlane);
+		}
+	}
+
+	// The layer covers the whole screen behind the opaque surface, tested like the rasterizer does
+	TransparencyBuffer transparencyBuffer{ Width, Height, 2 };
+	const float* pLayerDepth = static_cast<const float*>(transparencyBuffer.DownsampleDepth(frameBuffer));
+	const float layerDepth = 1.f - GetReversedDepth(LayerViewDepth, NearPlane, FarPlane);
+	for (int pixelIndex = 0; pixelIndex < transparencyBuffer.GetWidth() * transparencyBuffer.GetHeight(); ++pixelIndex)
+	{
+		if (!DepthTraits<DepthFormat::Float32>::Passes(layerDepth, pLayerDepth[pixelIndex])) continue;
+		transparencyBuffer.Accumulate(pixelIndex, ColorRGB{ 1.f, 0.f, 0.f }, .5f, LayerViewDepth);
+	}
+
+	transparencyBuffer.Composite(format, frameBuffer, NearPlane, FarPlane);
+	frameBuffer.ResolveColor();
+
+	bool isOpaqueKept{ true };
+	bool isBackgroundCovered{ true };
+	for (int y = 0; y < Height; ++y)
+	{
+		for (int x = 0; x < Width; ++x)
+		{
+			const uint32_t pixel = presentPixels[size_t(y) * Width + x];
+			if (IsOpaque(x)) isOpaqueKept &= pixel == opaqueColor;
+			// Right next to the edge the nearest samples may all be rejected, further away the layer has to show
+			else if (!IsOpaque(x - 1) && !IsOpaque(x + 1)) isBackgroundCovered &= pixel != backgroundColor;
+		}
+	}
+
+	bool passed{ true };
+	passed &= Check("Opaque pixels in front of the layers keep their color", isOpaqueKept);
+	passed &= Check("Background pixels behind the layers are covered", isBackgroundCovered);
+
+	SDL_FreeFormat(pSDLFormat);
+	return passed ? 0 : 1;
+}